@@ -0,0 +1,11 @@
+// controller input the benchmarks feed every rom, so nesbench and ppubench run through the same frames
+#pragma once
+#include <cstdint>
+
+//the same input every run, start gets pressed now and then and the rest of the time the player runs right and jumps
+inline uint8_t scriptedInput(int frame) {
+    if (frame % 240 < 4) {
+        return 0x08;
+    }
+    return (frame % 40 < 20) ? 0x81 : 0x80;
+}
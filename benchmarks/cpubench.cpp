@@ -0,0 +1,294 @@
+//cpubench, times every opcode on its own on the flat testing ram to find the slow handlers
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <fstream>
+#include <getopt.h>
+#include <nlohmann/json.hpp>
+#include "Emulator.h"
+#include "Log.h"
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+//host instructions and branch misses around a run, read as one perf event group
+//containers and locked down kernels often refuse perf events, then only the times are reported
+class HostCounters {
+public:
+    HostCounters() {
+#ifdef __linux__
+        instructionsFd = open(PERF_COUNT_HW_INSTRUCTIONS, -1);
+        if (instructionsFd >= 0) {
+            branchMissesFd = open(PERF_COUNT_HW_BRANCH_MISSES, instructionsFd);
+        }
+#endif
+    }
+    ~HostCounters() {
+#ifdef __linux__
+        if (branchMissesFd >= 0) close(branchMissesFd);
+        if (instructionsFd >= 0) close(instructionsFd);
+#endif
+    }
+
+    bool available() {
+        return branchMissesFd >= 0;
+    }
+
+    void start() {
+#ifdef __linux__
+        if (available()) {
+            ioctl(instructionsFd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+            ioctl(instructionsFd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        }
+#endif
+    }
+
+    //false if nothing was counted
+    bool stop(long long &instructions, long long &branchMisses) {
+#ifdef __linux__
+        if (available()) {
+            ioctl(instructionsFd, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+            //PERF_FORMAT_GROUP reads the number of events and then their values
+            uint64_t values[3];
+            if (read(instructionsFd, values, sizeof(values)) == sizeof(values) && values[0] == 2) {
+                instructions = values[1];
+                branchMisses = values[2];
+                return true;
+            }
+        }
+#endif
+        return false;
+    }
+
+private:
+    int instructionsFd = -1;
+    int branchMissesFd = -1;
+
+#ifdef __linux__
+    static int open(uint64_t config, int groupFd) {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = config;
+        attr.disabled = groupFd < 0;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP;
+        return syscall(SYS_perf_event_open, &attr, 0, -1, groupFd, 0);
+    }
+#endif
+};
+
+struct Options {
+    int count = 100000;
+    int repetitions = 5;
+    bool referenceCore = false;
+    //an opcode is an outlier when it is this many times slower than the median of its addressing mode
+    double outlierRatio = 1.5;
+    const char *output = nullptr;
+};
+
+//per emulated instruction, counters are negative when perf events are not available
+struct Sample {
+    double ns = 0;
+    double instructions = -1;
+    double branchMisses = -1;
+};
+
+struct OpcodeResult {
+    int opcode;
+    const char *mnemonic;
+    const char *mode;
+    Sample isolated;
+    Sample loop;
+};
+
+//fastest of the repetitions, the one least disturbed by the rest of the machine
+template <typename Run>
+static Sample measure(Run run, const Options &options, HostCounters &counters) {
+    Sample best;
+    best.ns = 1e30;
+    run(options.count / 10 + 1);
+    for (int repetition = 0; repetition < options.repetitions; repetition++) {
+        long long instructions = 0;
+        long long branchMisses = 0;
+        counters.start();
+        auto start = std::chrono::steady_clock::now();
+        run(options.count);
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+        bool counted = counters.stop(instructions, branchMisses);
+        if (ns / options.count < best.ns) {
+            best.ns = ns / options.count;
+            best.instructions = counted ? (double)instructions / options.count : -1;
+            best.branchMisses = counted ? (double)branchMisses / options.count : -1;
+        }
+    }
+    return best;
+}
+
+static double median(std::vector<double> values) {
+    std::sort(values.begin(), values.end());
+    size_t middle = values.size() / 2;
+    return values.size() % 2 ? values[middle] : (values[middle - 1] + values[middle]) / 2;
+}
+
+static void printCounter(double value, const char *format) {
+    if (value < 0) {
+        printf("%10s", "-");
+    } else {
+        printf(format, value);
+    }
+}
+
+static nlohmann::json sampleJson(const Sample &sample) {
+    nlohmann::json json;
+    json["ns"] = sample.ns;
+    json["host_instructions"] = sample.instructions < 0 ? nlohmann::json() : nlohmann::json(sample.instructions);
+    json["branch_misses"] = sample.branchMisses < 0 ? nlohmann::json() : nlohmann::json(sample.branchMisses);
+    return json;
+}
+
+static void usage() {
+    fprintf(stderr,
+        "usage: cpubench [options]\n"
+        "  -n, --count N         instructions per timed run, default 100000\n"
+        "  -r, --repetitions N   timed runs per opcode, the fastest is kept, default 5\n"
+        "  -R, --reference-core  time the opcodeTable interpreter instead of the specialized handlers\n"
+        "  -x, --outlier RATIO   flag opcodes this much slower than their addressing mode, default 1.5\n"
+        "  -o, --output FILE     write the results as json\n");
+}
+
+int main(int argc, char **argv) {
+    Options options;
+    static const option longOptions[] = {
+        {"count", required_argument, nullptr, 'n'},
+        {"repetitions", required_argument, nullptr, 'r'},
+        {"reference-core", no_argument, nullptr, 'R'},
+        {"outlier", required_argument, nullptr, 'x'},
+        {"output", required_argument, nullptr, 'o'},
+        {"help", no_argument, nullptr, 'h'},
+        {nullptr, 0, nullptr, 0}
+    };
+    int flag;
+    while ((flag = getopt_long(argc, argv, "n:r:Rx:o:h", longOptions, nullptr)) != -1) {
+        switch (flag) {
+            case 'n':
+                options.count = atoi(optarg);
+                break;
+            case 'r':
+                options.repetitions = atoi(optarg);
+                break;
+            case 'R':
+                options.referenceCore = true;
+                break;
+            case 'x':
+                options.outlierRatio = atof(optarg);
+                break;
+            case 'o':
+                options.output = optarg;
+                break;
+            default:
+                usage();
+                return flag == 'h' ? 0 : 2;
+        }
+    }
+    if (optind != argc || options.count <= 0 || options.repetitions <= 0) {
+        usage();
+        return 2;
+    }
+    setLogHandler(nullptr);
+
+    //big, testRam alone is 64kb
+    Emulator *emulator = new Emulator();
+    emulator->setReferenceCore(options.referenceCore);
+    HostCounters counters;
+    if (!counters.available()) {
+        fprintf(stderr, "cpubench: perf events not available, host instructions and branch misses are left out\n");
+    }
+
+    //isolated runs the handler alone from the same state every time, loop fetches it through runInstruction
+    std::vector<OpcodeResult> results;
+    printf("%-4s %-5s %-5s %10s %10s %10s %10s\n", "op", "name", "mode", "iso ns", "loop ns", "instr", "br miss");
+    for (int opcode = 0; opcode < 0x100; opcode++) {
+        if (!CPU::opcodeRuns(opcode)) {
+            continue;
+        }
+        OpcodeResult result = {opcode, CPU::opcodeMnemonic(opcode), CPU::addressingModeName(opcode), {}, {}};
+        emulator->beginOpcodeBenchmark(opcode);
+        result.isolated = measure([&](int count) { emulator->runOpcodeIsolated(opcode, count); }, options, counters);
+        emulator->beginOpcodeBenchmark(opcode);
+        result.loop = measure([&](int count) { emulator->runOpcodeLoop(count); }, options, counters);
+
+        printf("$%02X  %-5s %-5s %10.2f %10.2f", opcode, result.mnemonic, result.mode, result.isolated.ns, result.loop.ns);
+        printCounter(result.loop.instructions, " %10.1f");
+        printCounter(result.loop.branchMisses, " %10.3f");
+        printf("\n");
+        results.push_back(result);
+    }
+    emulator->endOpcodeBenchmark();
+    delete emulator;
+
+    std::map<std::string, std::vector<double>> modeIsolated;
+    std::map<std::string, std::vector<double>> modeLoop;
+    for (const OpcodeResult &result : results) {
+        modeIsolated[result.mode].push_back(result.isolated.ns);
+        modeLoop[result.mode].push_back(result.loop.ns);
+    }
+    std::map<std::string, double> modeMedian;
+    printf("\n%-5s %8s %12s %12s\n", "mode", "opcodes", "median iso", "median loop");
+    for (const auto &mode : modeIsolated) {
+        modeMedian[mode.first] = median(mode.second);
+        printf("%-5s %8zu %12.2f %12.2f\n", mode.first.c_str(), mode.second.size(), modeMedian[mode.first], median(modeLoop[mode.first]));
+    }
+
+    //slowest first
+    std::vector<std::pair<double, const OpcodeResult *>> outliers;
+    for (const OpcodeResult &result : results) {
+        double ratio = result.isolated.ns / modeMedian[result.mode];
+        if (ratio >= options.outlierRatio) {
+            outliers.push_back({ratio, &result});
+        }
+    }
+    std::sort(outliers.begin(), outliers.end(), [](const auto &a, const auto &b) { return a.first > b.first; });
+    printf("\noutliers, at least %.2fx the median of their addressing mode\n", options.outlierRatio);
+    for (const auto &outlier : outliers) {
+        printf("$%02X  %-5s %-5s %10.2f ns %6.2fx\n", outlier.second->opcode, outlier.second->mnemonic, outlier.second->mode, outlier.second->isolated.ns, outlier.first);
+    }
+
+    if (options.output != nullptr) {
+        nlohmann::json json;
+        json["core"] = options.referenceCore ? "reference" : "specialized";
+        json["count"] = options.count;
+        json["repetitions"] = options.repetitions;
+        for (const OpcodeResult &result : results) {
+            char opcode[8];
+            snprintf(opcode, sizeof(opcode), "%02X", result.opcode);
+            nlohmann::json &entry = json["opcodes"][opcode];
+            entry["mnemonic"] = result.mnemonic;
+            entry["mode"] = result.mode;
+            entry["isolated"] = sampleJson(result.isolated);
+            entry["loop"] = sampleJson(result.loop);
+            entry["outlier"] = result.isolated.ns / modeMedian[result.mode] >= options.outlierRatio;
+        }
+        for (const auto &mode : modeIsolated) {
+            json["modes"][mode.first]["isolated_ns"] = modeMedian[mode.first];
+            json["modes"][mode.first]["loop_ns"] = median(modeLoop[mode.first]);
+        }
+        std::ofstream file(options.output);
+        file << json.dump(4) << "\n";
+        if (!file) {
+            fprintf(stderr, "cpubench: Could not write %s\n", options.output);
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,259 @@
+//nesbench, times whole roms on the core and checks them against a baseline, run by meson benchmark
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <getopt.h>
+#include <nlohmann/json.hpp>
+#include "Emulator.h"
+#include "Log.h"
+#include "ScriptedInput.h"
+
+struct Options {
+    int frames = 300;
+    int warmup = 60;
+    int repetitions = 10;
+    //allowed slowdown against the baseline, as a fraction
+    double threshold = 0.10;
+    const char *output = nullptr;
+    const char *baseline = nullptr;
+    //the cpu fast paths, the defaults are what nes_create gives embedders
+    bool idleSkip = true;
+    bool blockBackend = false;
+};
+
+struct RomResult {
+    std::string name;
+    std::vector<double> fps;
+    double mean = 0;
+    double stddev = 0;
+    //half width of the 95% confidence interval of the mean
+    double ci95 = 0;
+    //fraction of the profiled run spent in each Emulator::ProfileSection
+    double split[Emulator::PROFILE_SECTIONS] = {0};
+};
+
+//two sided 95% student t values for 1 to 30 degrees of freedom, the normal value after that
+static double tValue(int degrees) {
+    static const double table[30] = {
+        12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+        2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+        2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+    };
+    if (degrees < 1) {
+        return 0;
+    }
+    return degrees <= 30 ? table[degrees - 1] : 1.960;
+}
+
+//every repetition starts from reset so they all run the same frames
+static int runFrames(Emulator &emulator, int start, int count) {
+    for (int frame = start; frame < start + count; frame++) {
+        emulator.controller1 = scriptedInput(frame);
+        emulator.runFrame();
+    }
+    return start + count;
+}
+
+static bool benchmarkRom(const char *path, const Options &options, RomResult &result) {
+    Emulator emulator;
+    *emulator.getIdleSkip() = options.idleSkip;
+    *emulator.getBlockBackend() = options.blockBackend;
+    if (!emulator.loadCartridge(path)) {
+        fprintf(stderr, "nesbench: Could not load %s (error %d)\n", path, emulator.loadResult);
+        return false;
+    }
+
+    std::string name = path;
+    name = name.substr(name.find_last_of('/') + 1);
+    result.name = name.substr(0, name.find_last_of('.'));
+
+    for (int repetition = 0; repetition < options.repetitions; repetition++) {
+        emulator.reset();
+        int frame = runFrames(emulator, 0, options.warmup);
+        auto start = std::chrono::steady_clock::now();
+        runFrames(emulator, frame, options.frames);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        result.fps.push_back(options.frames / seconds);
+    }
+
+    int count = result.fps.size();
+    for (double fps : result.fps) {
+        result.mean += fps / count;
+    }
+    for (double fps : result.fps) {
+        result.stddev += (fps - result.mean) * (fps - result.mean);
+    }
+    result.stddev = count > 1 ? sqrt(result.stddev / (count - 1)) : 0;
+    result.ci95 = count > 1 ? tValue(count - 1) * result.stddev / sqrt(count) : 0;
+
+    //one more run with the profiler on for the split, its clock reads would skew the fps
+    emulator.reset();
+    int frame = runFrames(emulator, 0, options.warmup);
+    *emulator.getProfiling() = true;
+    emulator.resetProfile();
+    runFrames(emulator, frame, options.frames);
+    *emulator.getProfiling() = false;
+
+    long long *nanos = emulator.getProfileNanos();
+    long long total = 0;
+    for (int section = 0; section < Emulator::PROFILE_SECTIONS; section++) {
+        total += nanos[section];
+    }
+    for (int section = 0; section < Emulator::PROFILE_SECTIONS; section++) {
+        result.split[section] = total > 0 ? (double)nanos[section] / total : 0;
+    }
+    return true;
+}
+
+static nlohmann::json toJson(const std::vector<RomResult> &results, const Options &options) {
+    nlohmann::json json;
+    json["frames"] = options.frames;
+    json["warmup"] = options.warmup;
+    json["repetitions"] = options.repetitions;
+    json["idle_skip"] = options.idleSkip;
+    json["block_backend"] = options.blockBackend;
+    for (const RomResult &result : results) {
+        nlohmann::json &rom = json["roms"][result.name];
+        rom["fps_mean"] = result.mean;
+        rom["fps_stddev"] = result.stddev;
+        rom["fps_ci95"] = result.ci95;
+        rom["ns_per_frame"] = result.mean > 0 ? 1e9 / result.mean : 0;
+        rom["fps"] = result.fps;
+        rom["split"]["cpu"] = result.split[Emulator::PROFILE_CPU];
+        rom["split"]["ppu"] = result.split[Emulator::PROFILE_PPU];
+        rom["split"]["bus"] = result.split[Emulator::PROFILE_BUS];
+    }
+    return json;
+}
+
+//a rom regressed when even the top of its confidence interval is below the allowed slowdown from the baseline mean
+static int compareBaseline(const std::vector<RomResult> &results, const Options &options) {
+    std::ifstream file(options.baseline);
+    if (!file) {
+        fprintf(stderr, "nesbench: Could not open baseline %s\n", options.baseline);
+        return 1;
+    }
+    nlohmann::json baseline = nlohmann::json::parse(file, nullptr, false);
+    if (baseline.is_discarded() || !baseline.contains("roms")) {
+        fprintf(stderr, "nesbench: Baseline %s is not valid\n", options.baseline);
+        return 1;
+    }
+
+    //numbers from another configuration of the fast paths say nothing about this one
+    if (baseline.value("idle_skip", true) != options.idleSkip || baseline.value("block_backend", false) != options.blockBackend) {
+        fprintf(stderr, "nesbench: Baseline %s was recorded with idle skip %s and block backend %s\n", options.baseline,
+            baseline.value("idle_skip", true) ? "on" : "off", baseline.value("block_backend", false) ? "on" : "off");
+        return 1;
+    }
+
+    int regressions = 0;
+    for (const RomResult &result : results) {
+        if (!baseline["roms"].contains(result.name)) {
+            printf("%-10s not in baseline\n", result.name.c_str());
+            continue;
+        }
+        double expected = baseline["roms"][result.name]["fps_mean"];
+        double change = (result.mean - expected) / expected;
+        bool regressed = result.mean + result.ci95 < expected * (1.0 - options.threshold);
+        regressions += regressed;
+        printf("%-10s %+6.1f%% against baseline %.1f fps%s\n", result.name.c_str(), change * 100, expected, regressed ? "  REGRESSION" : "");
+    }
+    return regressions > 0;
+}
+
+static void usage() {
+    fprintf(stderr,
+        "usage: nesbench [options] rom...\n"
+        "  -f, --frames N        timed frames per repetition, default 300\n"
+        "  -w, --warmup N        frames run after reset before timing, default 60\n"
+        "  -n, --repetitions N   timed runs per rom, default 10\n"
+        "  -o, --output FILE     write the results as json\n"
+        "  -b, --baseline FILE   fail if a rom is slower than this earlier output\n"
+        "  -t, --threshold PCT   slowdown against the baseline allowed, default 10\n"
+        "      --no-idle-skip    run polling loops instead of skipping them\n"
+        "      --block-backend   run hot code through the block translation backend\n");
+}
+
+int main(int argc, char **argv) {
+    Options options;
+    static const option longOptions[] = {
+        {"frames", required_argument, nullptr, 'f'},
+        {"warmup", required_argument, nullptr, 'w'},
+        {"repetitions", required_argument, nullptr, 'n'},
+        {"output", required_argument, nullptr, 'o'},
+        {"baseline", required_argument, nullptr, 'b'},
+        {"threshold", required_argument, nullptr, 't'},
+        {"no-idle-skip", no_argument, nullptr, 'I'},
+        {"block-backend", no_argument, nullptr, 'B'},
+        {"help", no_argument, nullptr, 'h'},
+        {nullptr, 0, nullptr, 0}
+    };
+    int flag;
+    while ((flag = getopt_long(argc, argv, "f:w:n:o:b:t:h", longOptions, nullptr)) != -1) {
+        switch (flag) {
+            case 'f':
+                options.frames = atoi(optarg);
+                break;
+            case 'w':
+                options.warmup = atoi(optarg);
+                break;
+            case 'n':
+                options.repetitions = atoi(optarg);
+                break;
+            case 'o':
+                options.output = optarg;
+                break;
+            case 'b':
+                options.baseline = optarg;
+                break;
+            case 't':
+                options.threshold = atof(optarg) / 100.0;
+                break;
+            case 'I':
+                options.idleSkip = false;
+                break;
+            case 'B':
+                options.blockBackend = true;
+                break;
+            default:
+                usage();
+                return flag == 'h' ? 0 : 2;
+        }
+    }
+    if (optind == argc || options.frames <= 0 || options.warmup < 0 || options.repetitions <= 0) {
+        usage();
+        return 2;
+    }
+    setLogHandler(nullptr);
+
+    std::vector<RomResult> results;
+    printf("idle skip %s, block backend %s\n", options.idleSkip ? "on" : "off", options.blockBackend ? "on" : "off");
+    printf("%-10s %10s %10s %12s %6s %6s %6s\n", "rom", "fps", "+-95%", "ns/frame", "cpu", "ppu", "bus");
+    for (int i = optind; i < argc; i++) {
+        RomResult result;
+        if (!benchmarkRom(argv[i], options, result)) {
+            return 1;
+        }
+        printf("%-10s %10.1f %10.1f %12.0f %5.1f%% %5.1f%% %5.1f%%\n", result.name.c_str(), result.mean, result.ci95, 1e9 / result.mean,
+            result.split[Emulator::PROFILE_CPU] * 100, result.split[Emulator::PROFILE_PPU] * 100, result.split[Emulator::PROFILE_BUS] * 100);
+        results.push_back(result);
+    }
+
+    if (options.output != nullptr) {
+        std::ofstream file(options.output);
+        file << toJson(results, options).dump(4) << "\n";
+        if (!file) {
+            fprintf(stderr, "nesbench: Could not write %s\n", options.output);
+            return 1;
+        }
+    }
+    if (options.baseline != nullptr) {
+        return compareBaseline(results, options);
+    }
+    return 0;
+}
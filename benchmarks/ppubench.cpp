@@ -0,0 +1,148 @@
+//ppubench, records one frame of a game's ppu inputs and times replaying them into the ppu with no cpu running
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <getopt.h>
+#include "Emulator.h"
+#include "Log.h"
+#include "ScriptedInput.h"
+
+struct Options {
+    int frame = 200;
+    int repetitions = 50;
+    int renderMode = PPU::RENDER_SCANLINE;
+    const char *saveDirectory = nullptr;
+};
+
+static bool endsWith(const std::string &text, const char *suffix) {
+    size_t length = strlen(suffix);
+    return text.size() >= length && text.compare(text.size() - length, length, suffix) == 0;
+}
+
+//file name without directory or extension
+static std::string inputName(const std::string &path) {
+    std::string name = path.substr(path.find_last_of('/') + 1);
+    return name.substr(0, name.find_last_of('.'));
+}
+
+static bool recordTrace(const char *romPath, const Options &options, PpuTrace &trace) {
+    Emulator emulator;
+    if (!emulator.loadCartridge(romPath)) {
+        fprintf(stderr, "ppubench: Could not load %s (error %d)\n", romPath, emulator.loadResult);
+        return false;
+    }
+    emulator.reset();
+    int frame = 0;
+    for (; frame < options.frame; frame++) {
+        emulator.controller1 = scriptedInput(frame);
+        emulator.runFrame();
+    }
+    //recording starts when the frame in progress ends
+    emulator.recordPpuTrace(&trace);
+    while (emulator.ppuTraceRecording()) {
+        emulator.controller1 = scriptedInput(frame++);
+        emulator.runFrame();
+    }
+    return true;
+}
+
+static void usage() {
+    fprintf(stderr,
+        "usage: ppubench [options] input...\n"
+        "  inputs ending in .ppt are saved traces, anything else is a rom to record one from\n"
+        "  -f, --frame N          frame of a rom to record, default 200\n"
+        "  -n, --repetitions N    timed replays per trace, default 50\n"
+        "  -m, --render-mode M    dot, scanline or verify, default scanline\n"
+        "  -s, --save DIR         write the traces recorded from roms to DIR/<name>.ppt\n");
+}
+
+int main(int argc, char **argv) {
+    Options options;
+    static const option longOptions[] = {
+        {"frame", required_argument, nullptr, 'f'},
+        {"repetitions", required_argument, nullptr, 'n'},
+        {"render-mode", required_argument, nullptr, 'm'},
+        {"save", required_argument, nullptr, 's'},
+        {"help", no_argument, nullptr, 'h'},
+        {nullptr, 0, nullptr, 0}
+    };
+    static const char *renderModes[] = {"dot", "scanline", "verify"};
+    int flag;
+    while ((flag = getopt_long(argc, argv, "f:n:m:s:h", longOptions, nullptr)) != -1) {
+        switch (flag) {
+            case 'f':
+                options.frame = atoi(optarg);
+                break;
+            case 'n':
+                options.repetitions = atoi(optarg);
+                break;
+            case 'm':
+                options.renderMode = -1;
+                for (int mode = 0; mode < 3; mode++) {
+                    if (strcmp(optarg, renderModes[mode]) == 0) {
+                        options.renderMode = mode;
+                    }
+                }
+                break;
+            case 's':
+                options.saveDirectory = optarg;
+                break;
+            default:
+                usage();
+                return flag == 'h' ? 0 : 2;
+        }
+    }
+    if (optind == argc || options.frame < 0 || options.repetitions <= 0 || options.renderMode < 0) {
+        usage();
+        return 2;
+    }
+    setLogHandler(nullptr);
+
+    int failed = 0;
+    printf("%-10s %8s %12s %12s %10s  %s\n", "input", "events", "ns/frame", "min ns", "fps", "picture");
+    for (int i = optind; i < argc; i++) {
+        std::string path = argv[i];
+        std::string name = inputName(path);
+        PpuTrace trace;
+        if (endsWith(path, ".ppt")) {
+            if (trace.load(path.c_str()) != 0) {
+                fprintf(stderr, "ppubench: Could not load trace %s\n", path.c_str());
+                return 1;
+            }
+        } else {
+            if (!recordTrace(path.c_str(), options, trace)) {
+                return 1;
+            }
+            if (options.saveDirectory != nullptr) {
+                std::string tracePath = std::string(options.saveDirectory) + "/" + name + ".ppt";
+                if (trace.save(tracePath.c_str()) != 0) {
+                    fprintf(stderr, "ppubench: Could not write %s\n", tracePath.c_str());
+                    return 1;
+                }
+            }
+        }
+
+        //every replay starts over from the recorded state, only the replay itself is timed
+        Emulator emulator;
+        *emulator.getRenderMode() = options.renderMode;
+        bool matches = true;
+        double total = 0;
+        double fastest = 1e30;
+        for (int repetition = 0; repetition < options.repetitions; repetition++) {
+            emulator.preparePpuReplay(trace);
+            auto start = std::chrono::steady_clock::now();
+            matches &= emulator.runPpuReplay(trace);
+            double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+            total += ns;
+            fastest = std::min(fastest, ns);
+        }
+        double mean = total / options.repetitions;
+        printf("%-10s %8zu %12.0f %12.0f %10.1f  %s\n", name.c_str(), trace.events.size(), mean, fastest, 1e9 / mean, matches ? "matches" : "DIFFERENT");
+        failed |= !matches;
+    }
+    return failed;
+}
@@ -0,0 +1,242 @@
+//nes-headless, runs a rom uncapped on the core library without a window and reports how fast it went
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <getopt.h>
+#include "src/nescore.h"
+
+//NTSC cpu cycles per frame, 341 * 262 ppu dots at 3 per cpu cycle
+static const double CPU_CYCLES_PER_FRAME = 341 * 262 / 3.0;
+static const double NTSC_FPS = 60.0988;
+
+//one line per frame of an FCEUX .fm2 movie, "|commands|RLDUTSBA|RLDUTSBA||", anything but '.' or ' ' is held
+//the button order from the left matches the NES_BUTTON bits from 7 down to 0
+struct MovieFrame {
+    uint8_t commands;
+    uint8_t buttons[2];
+};
+
+static int loadMovie(const char *path, std::vector<MovieFrame> &movie) {
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL) {
+        fprintf(stderr, "nes-headless: Could not open movie %s\n", path);
+        return 1;
+    }
+    char line[256];
+    while (fgets(line, sizeof(line), fp)) {
+        //header lines are key value pairs
+        if (line[0] != '|') {
+            continue;
+        }
+        MovieFrame frame = {0, {0, 0}};
+        char *field = line + 1;
+        frame.commands = atoi(field);
+        for (int port = 0; port < 2; port++) {
+            field = strchr(field, '|');
+            if (field == nullptr) {
+                break;
+            }
+            field++;
+            for (int bit = 0; bit < 8 && field[bit] != '|' && field[bit] != '\0' && field[bit] != '\n'; bit++) {
+                if (field[bit] != '.' && field[bit] != ' ') {
+                    frame.buttons[port] |= 0x80 >> bit;
+                }
+            }
+        }
+        movie.push_back(frame);
+    }
+    fclose(fp);
+    return 0;
+}
+
+struct FrameHashes {
+    nes_emulator *nes;
+    FILE *output;
+    int frame;
+};
+
+//the callback's frame is the one nes_frame_hash reads
+static void onFrame(void *user, const uint8_t *, const uint8_t *) {
+    FrameHashes *hashes = (FrameHashes *)user;
+    fprintf(hashes->output, "%d %016llx\n", hashes->frame++, (unsigned long long)nes_frame_hash(hashes->nes));
+}
+
+static int dumpFrame(nes_emulator *nes, const char *path) {
+    std::vector<uint32_t> rgba(NES_FRAME_WIDTH * NES_FRAME_HEIGHT);
+    nes_frame_rgba(nes, rgba.data(), NES_FRAME_WIDTH * 4);
+
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL) {
+        fprintf(stderr, "nes-headless: Could not write %s\n", path);
+        return 1;
+    }
+    //binary ppm, 0xRRGGBBAA pixels lose their alpha
+    fprintf(fp, "P6\n%d %d\n255\n", NES_FRAME_WIDTH, NES_FRAME_HEIGHT);
+    for (uint32_t color : rgba) {
+        uint8_t rgb[3] = {(uint8_t)(color >> 24), (uint8_t)(color >> 16), (uint8_t)(color >> 8)};
+        fwrite(rgb, 1, 3, fp);
+    }
+    fclose(fp);
+    return 0;
+}
+
+static int dumpRam(nes_emulator *nes, const char *path) {
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL) {
+        fprintf(stderr, "nes-headless: Could not write %s\n", path);
+        return 1;
+    }
+    fwrite(nes_ram(nes), 1, NES_RAM_SIZE, fp);
+    fclose(fp);
+    return 0;
+}
+
+static void usage() {
+    fprintf(stderr,
+        "usage: nes-headless [options] rom\n"
+        "  -f, --frames N          frames to run, default 600 or the length of the movie\n"
+        "  -m, --movie FILE        controller input from an .fm2 movie\n"
+        "  -o, --dump-frame FILE   write the last frame as a ppm\n"
+        "  -H, --hash-frames FILE  write a hash of every frame, - for stdout\n"
+        "  -r, --dump-ram FILE     write the 2kb of cpu ram after the last frame\n"
+        "  -v, --verbose           show the core's status lines\n"
+        "      --no-idle-skip      run polling loops instead of skipping them\n"
+        "      --block-backend     run hot code through the threaded block backend\n");
+}
+
+int main(int argc, char **argv) {
+    int frames = -1;
+    const char *moviePath = nullptr;
+    const char *framePath = nullptr;
+    const char *hashPath = nullptr;
+    const char *ramPath = nullptr;
+    bool verbose = false;
+    bool idleSkip = true;
+    bool blockBackend = false;
+
+    static const option options[] = {
+        {"frames", required_argument, nullptr, 'f'},
+        {"movie", required_argument, nullptr, 'm'},
+        {"dump-frame", required_argument, nullptr, 'o'},
+        {"hash-frames", required_argument, nullptr, 'H'},
+        {"dump-ram", required_argument, nullptr, 'r'},
+        {"verbose", no_argument, nullptr, 'v'},
+        {"no-idle-skip", no_argument, nullptr, 'I'},
+        {"block-backend", no_argument, nullptr, 'B'},
+        {"help", no_argument, nullptr, 'h'},
+        {nullptr, 0, nullptr, 0}
+    };
+    int flag;
+    while ((flag = getopt_long(argc, argv, "f:m:o:H:r:vh", options, nullptr)) != -1) {
+        switch (flag) {
+            case 'f':
+                frames = atoi(optarg);
+                break;
+            case 'm':
+                moviePath = optarg;
+                break;
+            case 'o':
+                framePath = optarg;
+                break;
+            case 'H':
+                hashPath = optarg;
+                break;
+            case 'r':
+                ramPath = optarg;
+                break;
+            case 'v':
+                verbose = true;
+                break;
+            case 'I':
+                idleSkip = false;
+                break;
+            case 'B':
+                blockBackend = true;
+                break;
+            default:
+                usage();
+                return flag == 'h' ? 0 : 2;
+        }
+    }
+    if (optind != argc - 1) {
+        usage();
+        return 2;
+    }
+    const char *romPath = argv[optind];
+
+    std::vector<MovieFrame> movie;
+    if (moviePath != nullptr && loadMovie(moviePath, movie) != 0) {
+        return 1;
+    }
+    if (frames < 0) {
+        frames = movie.empty() ? 600 : (int)movie.size();
+    }
+
+    if (!verbose) {
+        nes_set_log_callback(nullptr);
+    }
+    nes_emulator *nes = nes_create();
+    if (nes == nullptr) {
+        fprintf(stderr, "nes-headless: Could not create the emulator\n");
+        return 1;
+    }
+    nes_set_idle_skip(nes, idleSkip);
+    nes_set_block_backend(nes, blockBackend);
+    int result = nes_load(nes, romPath);
+    if (result != NES_OK) {
+        fprintf(stderr, "nes-headless: Could not load %s (error %d)\n", romPath, result);
+        nes_destroy(nes);
+        return 1;
+    }
+
+    FrameHashes hashes = {nes, nullptr, 0};
+    if (hashPath != nullptr) {
+        hashes.output = strcmp(hashPath, "-") == 0 ? stdout : fopen(hashPath, "w");
+        if (hashes.output == NULL) {
+            fprintf(stderr, "nes-headless: Could not write %s\n", hashPath);
+            nes_destroy(nes);
+            return 1;
+        }
+        nes_set_frame_callback(nes, onFrame, &hashes);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < frames; frame++) {
+        if (frame < (int)movie.size()) {
+            //command bits 0 and 1 are soft and hard reset
+            if (movie[frame].commands & 0x03) {
+                nes_reset(nes);
+            }
+            nes_set_buttons(nes, 0, movie[frame].buttons[0]);
+            nes_set_buttons(nes, 1, movie[frame].buttons[1]);
+        } else if (frame == (int)movie.size()) {
+            nes_set_buttons(nes, 0, 0);
+            nes_set_buttons(nes, 1, 0);
+        }
+        nes_frame(nes);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (hashes.output != nullptr && hashes.output != stdout) {
+        fclose(hashes.output);
+    }
+    int failed = 0;
+    if (framePath != nullptr) {
+        failed |= dumpFrame(nes, framePath);
+    }
+    if (ramPath != nullptr) {
+        failed |= dumpRam(nes, ramPath);
+    }
+    nes_destroy(nes);
+
+    //throughput goes to stderr so per frame hashes on stdout stay clean
+    double fps = seconds > 0 ? frames / seconds : 0;
+    fprintf(stderr, "nes-headless: %d frames in %.3f s, %.1f fps (%.1fx realtime), %.2f MHz cpu equivalent, %.0f ns/frame, idle skip %s, block backend %s\n",
+        frames, seconds, fps, fps / NTSC_FPS, fps * CPU_CYCLES_PER_FRAME / 1e6, frames > 0 ? seconds * 1e9 / frames : 0,
+        idleSkip ? "on" : "off", blockBackend ? "on" : "off");
+    return failed;
+}
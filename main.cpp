@@ -41,8 +41,18 @@ int main(int, char**)
     //pixel buffer, really just a texture with some extra stuff for nes debugging
     PixelBuffer* pixelBuffer = new PixelBuffer(renderer, DEFAULT_WIDTH, DEFAULT_HEIGHT);
 
+    //rom library, rebuilt when there is no usable index yet
+    RomLibrary *library = new RomLibrary();
+    if (library->open(ROM_INDEX_PATH) != 0) {
+        library->build(ROM_DIRECTORY, ROM_INDEX_PATH, HEADER_FIXES_PATH);
+    }
+
     //emulator pointer for easy reset
     Emulator *emulator = new Emulator(pixelBuffer);
+    emulator->library = library;
+    emulator->loadCartridge(emulator->cartName);
+    emulator->reset();
+    emulator->updatePatternTables();
 
     DebugWindow* debugWindow = new DebugWindow(window, gl_context, emulator, pixelBuffer);
 
@@ -136,6 +146,9 @@ int main(int, char**)
     
     //Cleanup
     delete debugWindow;
+    //the debug window may have swapped in a rescanned library
+    library = emulator->library;
     delete pixelBuffer;
     delete emulator;
+    delete library;
 }
\ No newline at end of file
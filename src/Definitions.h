@@ -13,6 +13,15 @@
 //for cartridge bank parsing
 #define CHR_ROM_BANKSIZE 8192
 #define PRG_ROM_BANKSIZE 16384
+#define PRG_RAM_SIZE 8192
+
+//roms given by name are looked up here, along with the rom library index and header fixes
+#define ROM_DIRECTORY "../testRoms"
+#define ROM_INDEX_PATH ROM_DIRECTORY "/library.idx"
+#define HEADER_FIXES_PATH ROM_DIRECTORY "/headerfixes.txt"
+
+//ppu dots in a frame, 341 per scanline
+#define PPU_DOTS_PER_FRAME (341 * 262)
 
 //ansii terminal color codes
 #define RED "\x1b[31m"
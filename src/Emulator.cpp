@@ -1,30 +1,29 @@
 #include "Emulator.h"
+#include "Log.h"
+#include <algorithm>
+#include <cstring>
 #include "components/CPU.h"
 #include "components/PPU.h"
 #include "components/Cartridge.h"
+#include "components/Mapper.h"
 
-Emulator::Emulator(PixelBuffer *pixelBuffer) {
-    printf(GREEN "Emulator: Started\n" RESET);
+Emulator::Emulator(FrameSink *sink) {
+    logPrintf(GREEN "Emulator: Started\n" RESET);
 
     this->cpu = new CPU(this);
-    printf(GREEN "Emulator: CPU created\n" RESET);
+    logPrintf(GREEN "Emulator: CPU created\n" RESET);
 
     this->ppu = new PPU(this);
-    printf(GREEN "Emulator: PPU created\n" RESET);
+    logPrintf(GREEN "Emulator: PPU created\n" RESET);
 
     this->cartridge = new Cartridge();
-    printf(GREEN "Emulator: Cartridge created\n" RESET);
+    logPrintf(GREEN "Emulator: Cartridge created\n" RESET);
 
-    this->cartridgeLoaded = (this->loadCartridge(this->cartName));
-    
-    //link pixel buffer
-    this->pixelBuffer = pixelBuffer;
-
-    reset();
-
-    if (cartridgeLoaded) {
-        updatePatternTables();
-        updatePalettes();
+    //the frame the ppu draws into never moves, handing it out now lets a frontend show the blank picture and
+    //frames in progress while stepping before the first one is finished
+    this->sink = sink;
+    if (sink) {
+        sink->frameReady(ppu->frame);
     }
 }
 
@@ -35,20 +34,19 @@ Emulator::~Emulator() {
 
     //check if log even exists
     if (logFile == NULL) {
-        printf(YELLOW "Emulator: logfile doesnt exist\n" RESET);
         return;
     }
     //check if log was ever written to and delete file if blank
     fseek(logFile, 0, SEEK_END);
     if (ftell(logFile) == 0) {
-        printf(YELLOW "Emulator: Log unused, deleting logfile\n" RESET);
+        logPrintf(YELLOW "Emulator: Log unused, deleting logfile\n" RESET);
         if (remove(filename) == 0) {
-            printf(GREEN "Emulator: Logfile deleted\n" RESET);
+            logPrintf(GREEN "Emulator: Logfile deleted\n" RESET);
         } else {
-            printf(RED "Emulator: Error deleting logfile\n" RESET);
+            logPrintf(RED "Emulator: Error deleting logfile\n" RESET);
         }
     } else {
-        printf(GREEN "Emulator: Keeping logfile\n" RESET);
+        logPrintf(GREEN "Emulator: Keeping logfile\n" RESET);
     }
     fclose(logFile);
 }
@@ -56,10 +54,33 @@ Emulator::~Emulator() {
 //testing opcodes
 void Emulator::testOpcodes() {
     TestingMode = true;
+    mapCpuPages();
 
     cpu->testOpcodes();
     
     TestingMode = false;
+    mapCpuPages();
+}
+
+void Emulator::beginOpcodeBenchmark(uint8_t opcodeByte) {
+    if (!TestingMode) {
+        TestingMode = true;
+        mapCpuPages();
+    }
+    cpu->prepareOpcodeBenchmark(opcodeByte);
+}
+
+void Emulator::endOpcodeBenchmark() {
+    TestingMode = false;
+    mapCpuPages();
+}
+
+void Emulator::runOpcodeIsolated(uint8_t opcodeByte, int count) {
+    cpu->benchmarkIsolated(opcodeByte, count);
+}
+
+void Emulator::runOpcodeLoop(int count) {
+    cpu->benchmarkLoop(count);
 }
 
 void Emulator::log(const char* message) {
@@ -71,37 +92,62 @@ int Emulator::runUntilBreak(int instructionRequest) {
     //this function will return to allow the frontend to render the frame or debug information
     //realtime means it breaks after every frame is finished generating, a specified instruction count will run that many
 
+    if (realtime) {
+        runFrame();
+        return 0;
+    }
+
     int instructionStart = instructionCount;
 
-    while ((realtime || (instructionCount < instructionStart + instructionRequest)) && pushFrame == false) {
-        clock();
+    stepping = true;
+    while (instructionCount < instructionStart + instructionRequest && pushFrame == false) {
+        run(1);
     }
+    stepping = false;
 
     pushFrame = false;
      
     return 0;
 }
 
-bool Emulator::loadCartridge(char *cartName)
+bool Emulator::loadCartridge(const char *cartName)
 {
     //returns 0 if cartridge was loaded correctly
-    if (cartridgeLoaded) {
-        delete cartridge;
-    }
+    //there is always a cartridge, the empty one from the constructor or whatever the last load left, failed or not
+    delete cartridge;
     cartridge = new Cartridge();
-    cartridgeLoaded = (cartridge->loadRom(cartName) == 0);
+    const RomLibrary::Entry *entry = library ? library->find(Cartridge::romPath(cartName).c_str()) : nullptr;
+    loadResult = cartridge->loadRom(cartName, entry ? &entry->header : nullptr);
+    cartridgeLoaded = loadResult == Cartridge::LOAD_OK;
+
+    //cached instructions and PRG pages belong to the old PRG-ROM
+    cpu->invalidateDecodeCache();
+    mapCpuPages();
+    mapPpuPages();
+    cartridge->bankChanges = 0;
+    scanlineCounter = cartridgeLoaded && cartridge->board->hasScanlineCounter();
+    //the pattern table viewer has to draw every tile of the new CHR
+    std::fill(patternTileDrawn, patternTileDrawn + 512, -1);
 
     return cartridgeLoaded;
 }
 
 void Emulator::reset() {
     if(cartridgeLoaded) {
-        printf(YELLOW "Emulator: Reset\n" RESET);
+        logPrintf(YELLOW "Emulator: Reset\n" RESET);
+        //mapper banks go back to their power on state before the cpu fetches the reset vector
+        cartridge->reset();
+        remapCartridge(cartridge->bankChanges);
         cpu->reset();
-        printf(YELLOW "Emulator: CPU Reset\n" RESET);
+        logPrintf(YELLOW "Emulator: CPU Reset\n" RESET);
         ppu->reset();
-        printf(YELLOW "Emulator: PPU Reset\n" RESET);
+        logPrintf(YELLOW "Emulator: PPU Reset\n" RESET);
         emulationTicks = 0;
+        nextCpuTick = 0;
+        ppuTicks = 0;
+        scanlineCountedTick = 0;
+        scanlineIrqTick = LLONG_MAX;
+        ppuEventTick = ppu->dotsUntilEvent();
         instructionCount = 0;
 
         updatePalettes();
@@ -113,9 +159,7 @@ void Emulator::reset() {
 }
 
 void Emulator::runSingleFrame() {
-    while (pushFrame == false) {
-        clock();
-    }
+    runFrame();
 }
 
 void Emulator::runSingleCycle() {
@@ -123,214 +167,607 @@ void Emulator::runSingleCycle() {
 }
 
 void Emulator::clock() {
-    if (emulationTicks % 3 == 0) {
-        if (DMA) {
-            //load OAM
-            if (DMASync) {
-                if (emulationTicks % 2 == 1) {
-                    DMASync = false;
-                }
-            } else {
-                //flip reads and writes
-                switch (emulationTicks % 2) {
-                    case 0:
-                        //read
-                        DMAData = cpuBusRead((DMAPage << 8) | DMAAddr);
-                        break;
-                    case 1:
-                        //write
-                        *((uint8_t*)ppu->OAM + DMAAddr) = DMAData;
-                        DMAAddr++;
-                        if (DMAAddr == 0) {
-                            //reset DMA
-                            DMA = false;
-                            DMASync = true;
-                        }
-                        break;
-                }
+    stepping = true;
+    run(1);
+    stepping = false;
+}
+
+void Emulator::runFrame() {
+    while (pushFrame == false) {
+        run(PPU_DOTS_PER_FRAME);
+    }
+    pushFrame = false;
+}
+
+long long Emulator::run(long long dots) {
+    //the cpu runs ahead of the ppu and the ppu catches up in one go, either when the cpu touches one of its
+    //registers or when the ppu reaches its next event (vblank NMI or frame end), which the cpu is never allowed past
+    long long start = emulationTicks;
+    long long end = emulationTicks + dots;
+    if (profiling) {
+        profileMark = std::chrono::steady_clock::now();
+        profileSection = PROFILE_CPU;
+    }
+
+    while (emulationTicks < end && pushFrame == false) {
+        //the cpu cycle on the event dot still runs before the ppu does
+        long long limit = std::min(end, ppuEventTick + 1);
+
+        while (nextCpuTick < limit) {
+            emulationTicks = nextCpuTick;
+            int batch = DMA ? 0 : cpu->freeCycles();
+            if (batch > 0) {
+                //cpu is only counting down, settle every cycle up to the limit at once
+                int ticks = std::min<long long>(batch, (limit - nextCpuTick + 2) / 3);
+                cpu->skipCycles(ticks);
+                nextCpuTick += 3LL * ticks;
+                continue;
             }
+            cpuTick();
+            nextCpuTick += 3;
+            //register writes can move the next event
+            limit = std::min(end, ppuEventTick + 1);
         }
-        else {
-            cpu->clock();
+
+        catchUpPpu(limit);
+        emulationTicks = ppuTicks;
+    }
+    if (profiling) {
+        enterProfileSection(PROFILE_CPU);
+    }
+    return emulationTicks - start;
+}
+
+void Emulator::catchUpPpu(long long target) {
+    ProfileScope profile(this, PROFILE_PPU);
+    while (ppuTicks < target) {
+        //visible lines that nothing touches before they end go through the scanline renderer in one call
+        int lineDots = ppu->scanlineDots();
+        if (lineDots > 0 && ppuTicks + lineDots <= target) {
+            ppu->runScanline();
+            ppuTicks += lineDots;
+            continue;
         }
+        pushFrame = ppu->clock();
+        ppuTicks++;
+        if (pushFrame) {
+            if (trace) {
+                traceFrameBoundary();
+            }
+            if (sink) {
+                sink->frameReady(ppu->frame);
+            }
+            break;
+        }
+    }
+    if (ppuTicks > scanlineIrqTick) {
+        //the ppu ran through the predicted IRQ dot
+        syncScanlineCounter();
     }
-    pushFrame = ppu->clock();
-    emulationTicks++;
+    updatePpuEvent();
 }
 
-CpuState *Emulator::getCpuState() {
-    return cpu->getState();
+void Emulator::updatePpuEvent() {
+    ppuEventTick = std::min(ppuTicks + ppu->dotsUntilEvent(), scanlineIrqTick);
 }
 
-uint8_t Emulator::cpuBusRead(uint16_t address) {
-    if (TestingMode) {
-        return testRam[address];
+long long Emulator::nextScanlineClock(long long tick) {
+    if (ppu->scanlineClockCycle() < 0) {
+        return -1;
     }
-    uint8_t data = 0;
-    //cpubus, start with cpuram
-    if ( 0x0000 <= address && address <= 0x1FFF)
-    {
-        //cpuram, AND with physical ram size because of mirroring
-        data = ram[address & 0x07FF];
+    return ppuTicks + ppu->dotsToScanlineClock(tick - ppuTicks);
+}
+
+void Emulator::syncScanlineCounter() {
+    if (!scanlineCounter) {
+        return;
     }
-    else if (address >= 0x2000 && address <= 0x3FFF)
-    {
-        //ppu registers and mirroring
-        data = ppu->readRegisters(address & 0x2007);
+    Mapper *board = cartridge->board;
+
+    //A12 timing only changes through register writes that sync first, so every dot since the last sync clocked the same way
+    for (long long clock = nextScanlineClock(scanlineCountedTick - 1); clock >= 0 && clock < ppuTicks; clock = nextScanlineClock(clock)) {
+        board->clockScanline();
     }
-    else if (address >= 0x4000 && address <= 0x401F)
-    {
-        //audio and input registers
-        if (address == 0x4016)
-        {
-            //controller
-            data = controller1ShiftReg & 1;
-            controller1ShiftReg >>= 1;
+    scanlineCountedTick = ppuTicks;
+    cpu->setIrq(CPU::IRQ_MAPPER, board->irq);
+
+    //predict the dot the counter will raise its next IRQ on, nothing has to look at it before then
+    scanlineIrqTick = LLONG_MAX;
+    int clocks = board->scanlinesUntilIrq();
+    if (clocks > 0) {
+        long long clock = nextScanlineClock(ppuTicks - 1);
+        for (int i = 1; i < clocks && clock >= 0; i++) {
+            clock = nextScanlineClock(clock);
         }
-        if (address == 0x4017)
-        {
-            //controller 2
-            data = controller2ShiftReg & 1;
-            controller2ShiftReg >>= 1;
+        if (clock >= 0) {
+            scanlineIrqTick = clock;
         }
     }
-    else if (address >= 0x4020)
-    {
-        //cartridge space
-        data = cartridge->read(address);
-    }
+}
 
-    return data;
+void Emulator::syncPpu() {
+    //bring the ppu up to the current cpu cycle, it has to have run every dot before it
+    catchUpPpu(emulationTicks);
 }
 
-void Emulator::cpuBusWrite(uint16_t address, uint8_t data) {
-    if (TestingMode) {
-        testRam[address] = data;
-        return;
-    }
-    if ( 0x0000 <= address && address <= 0x1FFF)
-    {
-        //cpuram, AND with physical ram size because of mirroring
-        ram[address & 0x07FF] = data;
-        return;
+int Emulator::dotsUntilPpuEvent() {
+    return (int)(ppuEventTick - emulationTicks);
+}
+
+void Emulator::cpuTick() {
+    if (DMA) {
+        ProfileScope profile(this, PROFILE_BUS);
+        //load OAM, dma reads on even and writes on odd master clock cycles
+        bool oddCycle = emulationTicks & 1;
+        if (DMASync) {
+            if (oddCycle) {
+                DMASync = false;
+            }
+        } else if (!oddCycle) {
+            //read
+            DMAData = cpuBusRead((DMAPage << 8) | DMAAddr);
+        } else {
+            //write, sprite evaluation reads OAM so the ppu has to be caught up first
+            syncPpu();
+            *((uint8_t*)ppu->OAM + DMAAddr) = DMAData;
+            if (trace) {
+                traceEvent(PpuTrace::EVENT_OAM_DMA, DMAAddr, DMAData);
+            }
+            DMAAddr++;
+            if (DMAAddr == 0) {
+                //reset DMA
+                DMA = false;
+                DMASync = true;
+            }
+        }
     }
-    else if (address >= 0x2000 && address <= 0x3FFF)
-    {
-        //control ppu registers
-        ppu->writeRegisters(address & 0x2007, data);
-        return;
+    else {
+        cpu->clock();
     }
-    else if (address >= 0x4000 && address <= 0x401F)
-    {
-        if (address == 0x4014) {
-            //Direct memory access for faster OAM loading
-            DMAAddr = 0;
-            DMA = true;
-            DMAPage = data;
-            return;
+}
+
+CpuState *Emulator::getCpuState() {
+    return cpu->getState();
+}
+
+void Emulator::mapCpuPages() {
+    //rebuilds the cpu memory map, called whenever the cartridge or testing mode changes
+    for (int page = 0; page < 256; page++) {
+        if (TestingMode) {
+            //flat 64kb of ram for the opcode tests
+            cpuReadPages[page] = testRam + (page << 8);
+            cpuWritePages[page] = testRam + (page << 8);
+            continue;
         }
-        if (address ==  0x4016)
-        {
-            //controller
-            if ((data & 1) == 0)
-            {
-                controller1ShiftReg = controller1;
-            }
+
+        cpuReadPages[page] = nullptr;
+        cpuWritePages[page] = nullptr;
+        if (page < 0x20) {
+            //$0000-$1FFF cpuram, 2kb mirrored four times
+            cpuReadPages[page] = ram + ((page & 0x07) << 8);
+            cpuWritePages[page] = ram + ((page & 0x07) << 8);
+        } else if (page < 0x40) {
+            //$2000-$3FFF ppu registers and mirroring
+            cpuReadHandlers[page] = &Emulator::ppuRegisterRead;
+            cpuWriteHandlers[page] = &Emulator::ppuRegisterWrite;
+        } else if (page == 0x40) {
+            //$4000-$401F audio and input registers, rest of the page is cartridge space
+            cpuReadHandlers[page] = &Emulator::ioRegisterRead;
+            cpuWriteHandlers[page] = &Emulator::ioRegisterWrite;
+        } else if (page >= 0x60 && page < 0x80 && cartridgeLoaded) {
+            //$6000-$7FFF PRG-RAM
+            cpuReadPages[page] = cartridge->prgRamPointer(page << 8);
+            cpuWritePages[page] = cartridge->prgRamPointer(page << 8);
+        } else if (page < 0x80 || !cartridgeLoaded) {
+            cpuReadHandlers[page] = cartridgeLoaded ? &Emulator::cartridgeRead : &Emulator::openBusRead;
+            cpuWriteHandlers[page] = &Emulator::ignoreWrite;
+        } else {
+            //$8000-$FFFF PRG-ROM, writes go to the mapper
+            cpuReadPages[page] = cartridge->prgPointer(page << 8);
+            cpuWriteHandlers[page] = &Emulator::cartridgeWrite;
         }
-        if (address == 0x4017)
-        {
-            //controller 2
-            if ((data & 1) == 0)
-            {
-                controller2ShiftReg = controller2;
+    }
+}
+
+void Emulator::remapCartridge(uint8_t changes) {
+    for (int slot = 0; slot < 4; slot++) {
+        if (changes & (Cartridge::CHANGED_PRG_SLOT << slot)) {
+            int start = 0x8000 + (slot << 13);
+            for (int page = start >> 8; page < (start >> 8) + 0x20; page++) {
+                cpuReadPages[page] = cartridge->prgPointer(page << 8);
             }
+            //code cached from the old bank cant be run from here anymore
+            cpu->invalidatePrgCode(start, start + 0x2000);
         }
-        return;
     }
-    return;
+    if (changes & (Cartridge::CHANGED_CHR | Cartridge::CHANGED_MIRRORING)) {
+        mapPpuPages();
+    }
+    cartridge->bankChanges = 0;
 }
 
-uint8_t Emulator::ppuBusRead(uint16_t address) {
-    if (address >= 0x0000 && address <= 0x1FFF)
-    {
-        return cartridge->read(address);
+void Emulator::mapPpuPages() {
+    //rebuilds the ppu memory map, called whenever the cartridge or its mirroring changes
+    for (int page = 0; page < 8; page++) {
+        //$0000-$1FFF pattern tables, CHR-ROM is read only
+        ppuReadPages[page] = cartridgeLoaded ? cartridge->chrPointer(page << 10) : ppuOpenBus;
+        ppuWritePages[page] = cartridgeLoaded ? cartridge->chrWritePointer(page << 10) : nullptr;
+    }
+
+    //nametable slot ($2000, $2400, $2800, $2C00) to the 1kb of vram it shows
+    uint8_t *nametables[4];
+    Cartridge::Mirroring mirroring = cartridgeLoaded ? cartridge->mirroring : Cartridge::MIRROR_HORIZONTAL;
+    for (int slot = 0; slot < 4; slot++) {
+        switch (mirroring) {
+            case Cartridge::MIRROR_VERTICAL:
+                nametables[slot] = ppu->nameTables[slot & 0x01];
+                break;
+            case Cartridge::MIRROR_SINGLE_LOW:
+                nametables[slot] = ppu->nameTables[0];
+                break;
+            case Cartridge::MIRROR_SINGLE_HIGH:
+                nametables[slot] = ppu->nameTables[1];
+                break;
+            case Cartridge::MIRROR_FOUR_SCREEN:
+                nametables[slot] = slot < 2 ? ppu->nameTables[slot] : cartridge->fourScreenRam + ((slot - 2) << 10);
+                break;
+            default:
+                nametables[slot] = ppu->nameTables[slot >> 1];
+                break;
+        }
     }
-    else if (address >= 0x2000 && address <= 0x23FF)
-    {
-        //nametable 0
-        return ppu->nameTables[0][address & 0x03FF];
+
+    //$2000-$2FFF, and $3000-$3EFF mirroring them
+    for (int page = 8; page < 16; page++) {
+        ppuReadPages[page] = nametables[page & 0x03];
+        ppuWritePages[page] = nametables[page & 0x03];
     }
-    else if (address >= 0x2400 && address <= 0x27FF)
-    {
-        //nametable 1
-        return ppu->nameTables[0][address & 0x03FF];
+}
+
+uint8_t Emulator::ppuRegisterRead(uint16_t address) {
+    ProfileScope profile(this, PROFILE_BUS);
+    syncPpu();
+    if (trace) {
+        traceEvent(PpuTrace::EVENT_REGISTER_READ, address & 0x0007, 0);
     }
-    else if (address >= 0x2800 && address <= 0x2BFF)
-    {
-        //nametable 2
-        return ppu->nameTables[1][address & 0x03FF];
+    return ppu->readRegisters(address & 0x2007);
+}
+
+void Emulator::ppuRegisterWrite(uint16_t address, uint8_t data) {
+    ProfileScope profile(this, PROFILE_BUS);
+    //control ppu registers
+    syncPpu();
+    //PPUCTRL and PPUMASK move the scanline counter clocks, count the ones under the old settings first
+    if (trace) {
+        traceEvent(PpuTrace::EVENT_REGISTER_WRITE, address & 0x0007, data);
     }
-    else if (address >= 0x2C00 && address <= 0x2FFF)
-    {
-        //nametable 3
-        return ppu->nameTables[1][address & 0x03FF];
+    bool clockChange = (address & 0x0007) <= 1;
+    if (clockChange) {
+        syncScanlineCounter();
+    }
+    ppu->writeRegisters(address & 0x2007, data);
+    if (clockChange) {
+        syncScanlineCounter();
     }
-    else if (address >= 0x3000 && address <= 0x3EFF)
+    //PPUCTRL can turn the vblank NMI on or off
+    updatePpuEvent();
+}
+
+uint8_t Emulator::ioRegisterRead(uint16_t address) {
+    ProfileScope profile(this, PROFILE_BUS);
+    uint8_t data = 0;
+    if (address >= 0x4020) {
+        return cartridgeRead(address);
+    }
+    if (address == 0x4016)
     {
-        //unused
-        return 0;
+        //controller
+        data = controller1ShiftReg & 1;
+        controller1ShiftReg >>= 1;
     }
-    else if (address >= 0x3F00 && address <= 0x3FFF)
+    if (address == 0x4017)
     {
-        return ppu->palettes[address & 0x001F];
+        //controller 2
+        data = controller2ShiftReg & 1;
+        controller2ShiftReg >>= 1;
     }
-    printf(RED "Emulator: invalid PPU read 0x%04X\n" RESET, address);
-    return 0;
+    return data;
 }
 
-void Emulator::ppuBusWrite(uint16_t address, uint8_t data) {
-    if (address >= 0x2000 && address <= 0x23FF)
-    {
-        //nametable 0
-        ppu->nameTables[0][address & 0x03FF] = data;
+void Emulator::ioRegisterWrite(uint16_t address, uint8_t data) {
+    ProfileScope profile(this, PROFILE_BUS);
+    if (address == 0x4014) {
+        //Direct memory access for faster OAM loading
+        DMAAddr = 0;
+        DMA = true;
+        DMAPage = data;
         return;
     }
-    else if (address >= 0x2400 && address <= 0x27FF)
+    if (address ==  0x4016)
     {
-        //nametable 1
-        ppu->nameTables[0][address & 0x03FF] = data;
-        return;
+        //controller
+        if ((data & 1) == 0)
+        {
+            controller1ShiftReg = controller1;
+        }
     }
-    else if (address >= 0x2800 && address <= 0x2BFF)
+    if (address == 0x4017)
     {
-        //nametable 2
-        ppu->nameTables[1][address & 0x03FF] = data;
-        return;
+        //controller 2
+        if ((data & 1) == 0)
+        {
+            controller2ShiftReg = controller2;
+        }
     }
-    else if (address >= 0x2C00 && address <= 0x2FFF)
-    {
-        //nametable 3
-        ppu->nameTables[1][address & 0x03FF] = data;
-        return;
+}
+
+uint8_t Emulator::cartridgeRead(uint16_t address) {
+    ProfileScope profile(this, PROFILE_BUS);
+    return cartridge->read(address);
+}
+
+void Emulator::cartridgeWrite(uint16_t address, uint8_t data) {
+    ProfileScope profile(this, PROFILE_BUS);
+    //the ppu has to draw everything up to now with the old CHR banks and mirroring
+    syncPpu();
+    syncScanlineCounter();
+    cartridge->write(address, data);
+    if (cartridge->bankChanges) {
+        uint8_t changes = cartridge->bankChanges;
+        remapCartridge(changes);
+        if (trace) {
+            traceBankChange(changes);
+        }
     }
-    else if (address >= 0x3000 && address <= 0x3EFF)
-    {
-        //unused
+    //counter and IRQ registers
+    syncScanlineCounter();
+    updatePpuEvent();
+}
+
+void Emulator::ignoreWrite(uint16_t address, uint8_t data) {
+    return;
+}
+
+uint8_t Emulator::openBusRead(uint16_t address) {
+    return 0;
+}
+
+bool *Emulator::getProfiling() {
+    return &profiling;
+}
+
+long long *Emulator::getProfileNanos() {
+    return profileNanos;
+}
+
+void Emulator::resetProfile() {
+    std::fill(profileNanos, profileNanos + PROFILE_SECTIONS, 0);
+}
+
+Emulator::ProfileSection Emulator::enterProfileSection(ProfileSection section) {
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    profileNanos[profileSection] += std::chrono::duration_cast<std::chrono::nanoseconds>(now - profileMark).count();
+    profileMark = now;
+    ProfileSection outer = profileSection;
+    profileSection = section;
+    return outer;
+}
+
+void Emulator::recordPpuTrace(PpuTrace *trace) {
+    this->trace = trace;
+    traceStarted = false;
+    trace->events.clear();
+}
+
+bool Emulator::ppuTraceRecording() {
+    return trace != nullptr;
+}
+
+void Emulator::traceFrameBoundary() {
+    if (traceStarted) {
+        trace->frameDots = ppuTicks - traceStartTick;
+        trace->frameHash = ppu->frame.hash();
+        trace = nullptr;
         return;
     }
-    else if (address >= 0x3F00 && address <= 0x3FFF)
-    {
-        ppu->palettes[address & 0x001F] = data;
+    traceStarted = true;
+    traceStartTick = ppuTicks;
+
+    PpuTrace::State &state = trace->state;
+    memset(&state, 0, sizeof(state));
+    state.ctrl = ppu->PPUCTRL.getValue();
+    state.mask = ppu->PPUMASK.getValue();
+    state.status = ppu->PPUSTATUS.getValue();
+    state.oamAddress = ppu->OAMADDR;
+    state.vramAddress = ppu->vramAddress.getValue();
+    state.tempVramAddress = ppu->tempVramAddress.getValue();
+    state.fineXScroll = ppu->fineXScroll;
+    state.writeToggle = ppu->writeToggle;
+    state.readBuffer = ppu->readBuffer;
+    state.spriteCount = ppu->spriteCount;
+    state.scanline = ppu->scanline;
+    state.cycle = ppu->cycle;
+    state.nextTile[0] = ppu->next_tile.id;
+    state.nextTile[1] = ppu->next_tile.attribute;
+    state.nextTile[2] = ppu->next_tile.lsb;
+    state.nextTile[3] = ppu->next_tile.msb;
+    state.shiftPattern[0] = ppu->shiftPattern.lowWord;
+    state.shiftPattern[1] = ppu->shiftPattern.highWord;
+    state.shiftAttribute[0] = ppu->shiftAttribute.lowWord;
+    state.shiftAttribute[1] = ppu->shiftAttribute.highWord;
+    memcpy(state.spriteInfo, ppu->spriteInfoBuffer, sizeof(state.spriteInfo));
+    memcpy(state.oam, ppu->OAM, sizeof(state.oam));
+    memcpy(state.palettes, ppu->palettes, sizeof(state.palettes));
+    memcpy(state.nameTables[0], ppu->nameTables, sizeof(ppu->nameTables));
+    memcpy(state.nameTables[2], cartridge->fourScreenRam, sizeof(cartridge->fourScreenRam));
+    for (int address = 0; address < 0x2000; address++) {
+        state.chr[address] = ppuReadPages[address >> 10][address & 0x03FF];
+    }
+    memcpy(traceChr, state.chr, sizeof(traceChr));
+    state.mirroring = cartridge->mirroring;
+    state.chrWritable = ppuWritePages[0] != nullptr;
+}
+
+void Emulator::traceEvent(PpuTrace::EventType type, uint16_t address, uint8_t value) {
+    if (!traceStarted) {
         return;
     }
-    printf(RED "Emulator: invalid PPU write 0x%04X\n" RESET, address);
-    return;
+    //pattern writes through $2007 land in the replay's CHR as well, keep its copy in step
+    if (type == PpuTrace::EVENT_REGISTER_WRITE && address == 7 && trace->state.chrWritable) {
+        uint16_t vram = ppu->vramAddress.getValue() & 0x3FFF;
+        if (vram < 0x2000) {
+            traceChr[vram] = value;
+        }
+    }
+    trace->events.push_back({(uint32_t)(ppuTicks - traceStartTick), type, value, address});
+}
+
+void Emulator::traceBankChange(uint8_t changes) {
+    if (changes & Cartridge::CHANGED_CHR) {
+        for (int address = 0; address < 0x2000; address++) {
+            uint8_t data = ppuReadPages[address >> 10][address & 0x03FF];
+            if (data != traceChr[address]) {
+                traceEvent(PpuTrace::EVENT_CHR, address, data);
+                traceChr[address] = data;
+            }
+        }
+    }
+    if (changes & Cartridge::CHANGED_MIRRORING) {
+        traceEvent(PpuTrace::EVENT_MIRRORING, 0, cartridge->mirroring);
+    }
+}
+
+void Emulator::preparePpuReplay(const PpuTrace &trace) {
+    const PpuTrace::State &state = trace.state;
+    delete cartridge;
+    cartridge = new Cartridge();
+    cartridge->loadChr(state.chr, (Cartridge::Mirroring)state.mirroring, state.chrWritable);
+    memcpy(cartridge->fourScreenRam, state.nameTables[2], sizeof(cartridge->fourScreenRam));
+    cartridgeLoaded = true;
+    loadResult = Cartridge::LOAD_OK;
+    cpu->invalidateDecodeCache();
+    mapCpuPages();
+    mapPpuPages();
+    cartridge->bankChanges = 0;
+    scanlineCounter = false;
+    std::fill(patternTileDrawn, patternTileDrawn + 512, -1);
+
+    ppu->PPUCTRL.setValue(state.ctrl);
+    ppu->PPUMASK.setValue(state.mask);
+    ppu->PPUSTATUS.setValue(state.status);
+    ppu->OAMADDR = state.oamAddress;
+    ppu->vramAddress.setValue(state.vramAddress);
+    ppu->tempVramAddress.setValue(state.tempVramAddress);
+    ppu->fineXScroll = state.fineXScroll;
+    ppu->writeToggle = state.writeToggle;
+    ppu->readBuffer = state.readBuffer;
+    ppu->spriteCount = state.spriteCount;
+    ppu->scanline = state.scanline;
+    ppu->cycle = state.cycle;
+    ppu->next_tile = {state.nextTile[0], state.nextTile[1], state.nextTile[2], state.nextTile[3]};
+    ppu->shiftPattern.lowWord = state.shiftPattern[0];
+    ppu->shiftPattern.highWord = state.shiftPattern[1];
+    ppu->shiftAttribute.lowWord = state.shiftAttribute[0];
+    ppu->shiftAttribute.highWord = state.shiftAttribute[1];
+    memcpy(ppu->spriteInfoBuffer, state.spriteInfo, sizeof(state.spriteInfo));
+    memcpy(ppu->OAM, state.oam, sizeof(state.oam));
+    memcpy(ppu->palettes, state.palettes, sizeof(state.palettes));
+    memcpy(ppu->nameTables, state.nameTables[0], sizeof(ppu->nameTables));
+
+    emulationTicks = 0;
+    nextCpuTick = 0;
+    ppuTicks = 0;
+    scanlineCountedTick = 0;
+    scanlineIrqTick = LLONG_MAX;
+    pushFrame = false;
+    updatePpuEvent();
+}
+
+bool Emulator::runPpuReplay(const PpuTrace &trace) {
+    replayingTrace = true;
+    for (const PpuTrace::Event &event : trace.events) {
+        catchUpPpu(event.dot);
+        switch (event.type) {
+            case PpuTrace::EVENT_REGISTER_WRITE:
+                ppu->writeRegisters(0x2000 | event.address, event.value);
+                break;
+            case PpuTrace::EVENT_REGISTER_READ:
+                ppu->readRegisters(0x2000 | event.address);
+                break;
+            case PpuTrace::EVENT_OAM_DMA:
+                *((uint8_t*)ppu->OAM + (event.address & 0xFF)) = event.value;
+                break;
+            case PpuTrace::EVENT_CHR:
+                cartridge->writeChr(event.address, event.value);
+                break;
+            case PpuTrace::EVENT_MIRRORING:
+                cartridge->mirroring = (Cartridge::Mirroring)event.value;
+                mapPpuPages();
+                break;
+        }
+    }
+    while (!pushFrame) {
+        catchUpPpu(ppuTicks + PPU_DOTS_PER_FRAME);
+    }
+    pushFrame = false;
+    replayingTrace = false;
+    emulationTicks = ppuTicks;
+    nextCpuTick = ppuTicks;
+    return ppuTicks == trace.frameDots && ppu->frame.hash() == trace.frameHash;
+}
+
+uint8_t *Emulator::getRam() {
+    return ram;
 }
 
 int *Emulator::getCycleCount() {
     return &cpu->cycleCount;
 }
 
+bool Emulator::getReferenceCore() {
+    return cpu->getReferenceCore();
+}
+
+void Emulator::setReferenceCore(bool enabled) {
+    cpu->setReferenceCore(enabled);
+}
+
+bool *Emulator::getBlockBackend() {
+    return &cpu->blockBackend;
+}
+
+bool *Emulator::getBlockCrossCheck() {
+    return &cpu->blockCrossCheck;
+}
+
+int Emulator::getBlocksTranslated() {
+    return cpu->blocksTranslated;
+}
+
+int Emulator::getBlockMismatches() {
+    return cpu->blockMismatches;
+}
+
+bool *Emulator::getIdleSkip() {
+    return &cpu->idleSkip;
+}
+
+long long Emulator::getIdleCyclesSkipped() {
+    return cpu->idleCyclesSkipped;
+}
+
+int *Emulator::getRenderMode() {
+    return &ppu->renderMode;
+}
+
+int Emulator::getScanlinesVerified() {
+    return ppu->scanlinesVerified;
+}
+
+int Emulator::getScanlineMismatches() {
+    return ppu->scanlineMismatches;
+}
+
 uint16_t Emulator::getPPUcycle() {
     return ppu->cycle;
 }
@@ -340,36 +777,50 @@ uint16_t Emulator::getPPUscanline() {
 }
 
 void Emulator::updatePatternTables() {
-    uint32_t pixels[128 * 128];
+    if (sink == nullptr || !cartridgeLoaded) {
+        return;
+    }
     uint8_t demoPalette[4] = {0x00, 0x10, 0x20, 0x3F};
     
     for (int table = 0; table < 2; table++)
     {
+        uint32_t *pixels = patternTablePixels[table];
+        bool changed = false;
         for (int y = 0; y < 16; y++) {
             for (int x = 0; x < 16; x++) {
+                //only tiles that were banked in or written since the last update are drawn again
+                int slot = table * 256 + y * 16 + x;
+                int chrTile = cartridge->chrAddress(slot * 16) >> 4;
+                if (patternTileDrawn[slot] == chrTile && patternTileVersion[slot] == cartridge->tiles->version(chrTile)) {
+                    continue;
+                }
+                patternTileDrawn[slot] = chrTile;
+                patternTileVersion[slot] = cartridge->tiles->version(chrTile);
+                changed = true;
+
                 //tile
                 for (int py = 0; py < 8; py++) {
-                    uint8_t lowByte = ppuBusRead((table * 0x1000) + (y * 16 + x) * 16 + py);
-                    uint8_t highByte = ppuBusRead((table * 0x1000) + (y * 16 + x) * 16 + py + 8);
+                    uint64_t row = cartridge->tiles->row((chrTile << 4) + py);
                     for (int px = 0; px < 8; px++) {
-                        uint8_t color = ((lowByte >> (7 - px)) & 0x01) | (((highByte >> (7 - px)) & 0x01) << 1);
-                        uint32_t colorValue = ppu->paletteTranslationTable[demoPalette[color]];
-
-                        //opengl texture insists on abgr format, no idea why, quick fix flips color channels
-                        colorValue = ((colorValue & 0xFF000000) >> 24) | ((colorValue & 0x00FF0000) >> 8)  | ((colorValue & 0x0000FF00) << 8)  | ((colorValue & 0x000000FF) << 24);
-
-                        pixels[(x * 8 + px) + (y * 8 + py) * 128] = colorValue;
+                        uint8_t color = (row >> (px * 8)) & 0x03;
+                        pixels[(x * 8 + px) + (y * 8 + py) * 128] = ppu->paletteTranslationTable[demoPalette[color]];
                     }
                 }
             }
         }
-        pixelBuffer->addPixelArrayToPatternTable(pixels, table);
+        if (changed) {
+            sink->patternTableReady(pixels, table);
+        }
     }
     return;
 }
 
 void Emulator::updatePalettes() {
+    if (sink == nullptr) {
+        return;
+    }
     //front end models this a little weird because of how the mirroring works, so it appears to be off by one position
+    uint32_t colors[32];
     for (int i = 0; i < 32; i++) {
         uint32_t color;
         if ((i % 4) == 0) {
@@ -379,11 +830,15 @@ void Emulator::updatePalettes() {
         else {
             color = ppu->paletteTranslationTable[ppu->palettes[i]];
         }
-        pixelBuffer->palettes[i / 4][i % 4] = ImVec4(((color & 0xFF000000) >> 24) / 255.0f, ((color & 0x00FF0000) >> 16) / 255.0f, ((color & 0x0000FF00) >> 8) / 255.0f, 1.0f);
+        colors[i] = color;
     }
+    sink->palettesReady(colors);
     return;
 }
 
 void Emulator::cpuNMI() {
+    if (replayingTrace) {
+        return;
+    }
     cpu->nmi();
 }
\ No newline at end of file
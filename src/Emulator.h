@@ -1,20 +1,25 @@
 #pragma once
 #include <cstdint>
+#include <climits>
+#include <chrono>
 #include <vector>
 #include "components/CPU.h"
 #include "components/PPU.h"
 #include "components/Cartridge.h"
+#include "components/RomLibrary.h"
+#include "components/PpuTrace.h"
 #include "Definitions.h"
 #include <iostream>
-#include "frontend/PixelBuffer.h"
+#include "FrameSink.h"
 
 class Emulator {
 public:
-    Emulator(PixelBuffer *pixelBuffer);
+    //starts without a cartridge, sink may be nullptr to run without any output
+    Emulator(FrameSink *sink = nullptr);
     ~Emulator();
 
-    //for ppu to directly render pixels
-    PixelBuffer *pixelBuffer;
+    //gets finished frames and the debug views
+    FrameSink *sink;
 
     //$4020–$FFFF cartridge address space, let debugwindow access
     Cartridge *cartridge;
@@ -23,10 +28,19 @@ public:
     PPU *ppu;
 
     int runUntilBreak(int instructionRequest);
-    bool loadCartridge(char* gamePath);
+    //false if the rom could not be loaded, loadResult says why
+    bool loadCartridge(const char* gamePath);
     void reset();
     void clock();
     void cpuNMI();
+
+    //scheduler, runs up to dots ppu dots or until a frame is finished, returns dots actually run
+    long long run(long long dots);
+    void runFrame();
+
+    //catches the ppu up to the current cpu cycle, anything that looks at ppu state mid run has to call this first
+    void syncPpu();
+    int dotsUntilPpuEvent();
     
     void runSingleInstruction();
     void runSingleFrame();
@@ -38,12 +52,105 @@ public:
     void updatePatternTables();
     void updatePalettes();
 
-    uint8_t cpuBusRead(uint16_t address);
-    void cpuBusWrite(uint16_t address, uint8_t data);
-    uint8_t ppuBusRead(uint16_t address);
-    void ppuBusWrite(uint16_t address, uint8_t data);
+    //cpu memory map, one entry per 256 byte page
+    //plain memory gets a direct pointer, pages without one go through their io handler
+    typedef uint8_t (Emulator::*CpuReadHandler)(uint16_t address);
+    typedef void (Emulator::*CpuWriteHandler)(uint16_t address, uint8_t data);
+    const uint8_t *cpuReadPages[256];
+    uint8_t *cpuWritePages[256];
+    CpuReadHandler cpuReadHandlers[256];
+    CpuWriteHandler cpuWriteHandlers[256];
+    void mapCpuPages();
+    //points the pages of the banks a mapper write moved at their new place
+    void remapCartridge(uint8_t changes);
+
+    inline uint8_t cpuBusRead(uint16_t address) {
+        const uint8_t *page = cpuReadPages[address >> 8];
+        if (page) {
+            return page[address & 0xFF];
+        }
+        return (this->*cpuReadHandlers[address >> 8])(address);
+    }
+    inline void cpuBusWrite(uint16_t address, uint8_t data) {
+        uint8_t *page = cpuWritePages[address >> 8];
+        if (page) {
+            page[address & 0xFF] = data;
+            if (address < 0x2000) {
+                cpu->ramWritten(address & 0x07FF);
+            }
+            return;
+        }
+        (this->*cpuWriteHandlers[address >> 8])(address, data);
+    }
+
+    //ppu memory map, one entry per 1kb page of $0000-$3FFF
+    //$0000-$1FFF point into CHR, $2000-$2FFF into the nametables picked by the cartridge mirroring and
+    //$3000-$3FFF mirror those, palette ram above $3F00 is checked before the table
+    //pages without a write pointer ignore writes, CHR-ROM pages have none
+    const uint8_t *ppuReadPages[16];
+    uint8_t *ppuWritePages[16];
+    void mapPpuPages();
 
+    inline uint8_t ppuBusRead(uint16_t address) {
+        address &= 0x3FFF;
+        if (address >= 0x3F00) {
+            return ppu->palettes[address & 0x001F];
+        }
+        return ppuReadPages[address >> 10][address & 0x03FF];
+    }
+    inline void ppuBusWrite(uint16_t address, uint8_t data) {
+        address &= 0x3FFF;
+        if (address >= 0x3F00) {
+            ppu->palettes[address & 0x001F] = data;
+            return;
+        }
+        uint8_t *page = ppuWritePages[address >> 10];
+        if (page) {
+            page[address & 0x03FF] = data;
+            //only CHR-RAM has writable pattern pages
+            if (address < 0x2000) {
+                cartridge->chrWritten(address);
+            }
+        }
+    }
+
+    //the 2kb of internal cpu ram
+    uint8_t *getRam();
     int *getCycleCount();
+    bool getReferenceCore();
+    void setReferenceCore(bool enabled);
+    bool *getBlockBackend();
+    bool *getBlockCrossCheck();
+    int getBlocksTranslated();
+    int getBlockMismatches();
+    bool *getIdleSkip();
+    long long getIdleCyclesSkipped();
+    int *getRenderMode();
+    int getScanlinesVerified();
+    int getScanlineMismatches();
+
+    //time spent in run, split between the cpu, the ppu catching up and the io register handlers (which includes DMA)
+    //each section only counts its own time, ppu time inside a register handler is ppu time
+    enum ProfileSection {
+        PROFILE_CPU,
+        PROFILE_PPU,
+        PROFILE_BUS,
+        PROFILE_SECTIONS
+    };
+    //off by default, it reads the clock around every ppu catch up and register access
+    bool *getProfiling();
+    //nanoseconds per section since the last resetProfile
+    long long *getProfileNanos();
+    void resetProfile();
+
+    //ppu traces, recording starts where the running frame ends and takes the whole next frame while the game runs
+    //normally, the trace is complete once ppuTraceRecording() is false again
+    void recordPpuTrace(PpuTrace *trace);
+    bool ppuTraceRecording();
+    //swaps the cartridge for one with the trace's CHR and puts the ppu where the frame started, load a rom to play again
+    void preparePpuReplay(const PpuTrace &trace);
+    //runs the ppu alone through the frame, feeding it the recorded events at their dots. true if it drew the same picture
+    bool runPpuReplay(const PpuTrace &trace);
 
     void log(const char* message);
 
@@ -53,10 +160,20 @@ public:
     //64kb ram for testing
     uint8_t testRam[0x10000];
 
+    //opcode microbenchmarks on the testing ram, begin fills it for one opcode and end maps the cartridge back
+    void beginOpcodeBenchmark(uint8_t opcodeByte);
+    void endOpcodeBenchmark();
+    void runOpcodeIsolated(uint8_t opcodeByte, int count);
+    void runOpcodeLoop(int count);
+
     bool cartridgeLoaded = false;
+    Cartridge::LoadResult loadResult = Cartridge::LOAD_NOT_FOUND;
 
     //toggles realtime emulation between instruction by instruction 
     bool realtime = false;
+    //set while runUntilBreak or clock steps single instructions or cycles, the cpu fast paths (idle loop skip and
+    //block backend) stay off then so every instruction is seen. whole frames run with them whatever realtime says
+    bool stepping = false;
 
     //debug information
     int instructionCount = 0;
@@ -65,14 +182,27 @@ public:
     bool logging = false;
 
     //for output of emulator logs
-    FILE* logFile;
+    FILE* logFile = nullptr;
     char filename[36];
 
     //cartridge
-    char cartName[25] = "nestest";
+    char cartName[256] = "nestest";
+    //index of the rom directory, owned by the frontend and shared by every emulator. roms in it load with the
+    //header stored there, nullptr to always parse the file
+    RomLibrary *library = nullptr;
 
-    //syncronize cpu and ppu
-    int emulationTicks = 0;
+    //master clock in ppu dots, syncronizes cpu and ppu
+    long long emulationTicks = 0;
+    //master clock timestamp of the next cpu cycle
+    long long nextCpuTick = 0;
+    //the ppu runs behind the cpu, this is the next dot it will run
+    long long ppuTicks = 0;
+    //dot of the ppu's next cpu visible event (or the cartridge's next scanline IRQ), the cpu never runs past it
+    long long ppuEventTick = 0;
+    //dot of the next scanline counter IRQ as predicted at the last counter sync
+    long long scanlineIrqTick = LLONG_MAX;
+    //counter clocks on dots before this one have been given to the cartridge
+    long long scanlineCountedTick = 0;
 
     int frameCount = 0;
 
@@ -94,12 +224,79 @@ private:
     //CPU
     CPU *cpu;
 
+    //one cpu cycle, or a DMA step while the cpu is halted
+    void cpuTick();
+    //runs the ppu up to (not including) target or the end of the frame
+    void catchUpPpu(long long target);
+    //recomputes ppuEventTick from the ppu and the scanline counter prediction
+    void updatePpuEvent();
+
+    //mapper scanline counters, clocked lazily for the dots the ppu has run whenever something could change
+    //when A12 rises (rendering enable, pattern tables, mapper registers) or a predicted IRQ is due
+    bool scanlineCounter = false;
+    void syncScanlineCounter();
+    //dot of the first counter clock after tick, -1 if there is none
+    long long nextScanlineClock(long long tick);
+
     //CPU bus
 
     //$0000–$07FF internal ram
     uint8_t ram[0x0800];
 
+    //what the ppu reads from CHR when there is no cartridge
+    uint8_t ppuOpenBus[0x400] = {0};
+
+    //pattern table viewer, which CHR tile (and version of it) each of the 512 tiles was last drawn from
+    uint32_t patternTablePixels[2][128 * 128];
+    int patternTileDrawn[512];
+    uint32_t patternTileVersion[512];
+
+    //io handlers for the cpu memory map
+    uint8_t ppuRegisterRead(uint16_t address);
+    void ppuRegisterWrite(uint16_t address, uint8_t data);
+    uint8_t ioRegisterRead(uint16_t address);
+    void ioRegisterWrite(uint16_t address, uint8_t data);
+    uint8_t cartridgeRead(uint16_t address);
+    void cartridgeWrite(uint16_t address, uint8_t data);
+    void ignoreWrite(uint16_t address, uint8_t data);
+    uint8_t openBusRead(uint16_t address);
+
     //set to true to break, assuming only ppu would need to trigger this 
     bool pushFrame = false;
+
+    bool profiling = false;
+    long long profileNanos[PROFILE_SECTIONS] = {0};
+    //section running since profileMark
+    ProfileSection profileSection = PROFILE_CPU;
+    std::chrono::steady_clock::time_point profileMark;
+    //charges the time since the last switch to the running section and switches to section, returns the old one
+    ProfileSection enterProfileSection(ProfileSection section);
+
+    //trace being recorded, nullptr when there is none
+    PpuTrace *trace = nullptr;
+    bool traceStarted = false;
+    long long traceStartTick = 0;
+    //pattern tables as a replay sees them so far, CHR bank switches are recorded as the bytes that differ from it
+    uint8_t traceChr[0x2000];
+    //there is no cpu to take the vblank NMI during a replay
+    bool replayingTrace = false;
+    void traceFrameBoundary();
+    void traceEvent(PpuTrace::EventType type, uint16_t address, uint8_t value);
+    void traceBankChange(uint8_t changes);
+
+    //charges a scope to a section while profiling
+    struct ProfileScope {
+        Emulator *emulator;
+        ProfileSection outer;
+        inline ProfileScope(Emulator *emulator, ProfileSection section) {
+            this->emulator = emulator;
+            this->outer = emulator->profiling ? emulator->enterProfileSection(section) : PROFILE_CPU;
+        }
+        inline ~ProfileScope() {
+            if (emulator->profiling) {
+                emulator->enterProfileSection(outer);
+            }
+        }
+    };
     
 };
\ No newline at end of file
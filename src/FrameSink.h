@@ -0,0 +1,16 @@
+// where the emulator sends its picture, the sdl frontend is one and embedders of the core bring their own
+#pragma once
+#include <cstdint>
+#include "components/FrameBuffer.h"
+
+class FrameSink {
+public:
+    virtual ~FrameSink() {}
+
+    //a frame was finished, it stays valid until the emulator runs again
+    virtual void frameReady(const FrameBuffer &frame) = 0;
+
+    //debug views, 128x128 pixels of pattern table 0 or 1 and the 32 colors of palette ram, all 0xRRGGBBAA
+    virtual void patternTableReady(const uint32_t *pixels, int table) {}
+    virtual void palettesReady(const uint32_t *colors) {}
+};
@@ -0,0 +1,28 @@
+#include "Log.h"
+#include <atomic>
+#include <cstdarg>
+#include <cstdio>
+
+static void printLine(const char *line) {
+    fputs(line, stdout);
+}
+
+//process wide, every emulator instance logs through the same handler
+static std::atomic<LogHandler> logHandler(printLine);
+
+void setLogHandler(LogHandler handler) {
+    logHandler = handler;
+}
+
+void logPrintf(const char *format, ...) {
+    LogHandler handler = logHandler;
+    if (handler == nullptr) {
+        return;
+    }
+    char line[512];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    handler(line);
+}
@@ -0,0 +1,11 @@
+// status and error lines from the emulator core
+#pragma once
+
+//gets every line the core prints, color codes included
+typedef void (*LogHandler)(const char *line);
+
+//nullptr silences the core, by default lines go to stdout
+void setLogHandler(LogHandler handler);
+
+//printf for the core, lines go to the log handler
+void logPrintf(const char *format, ...) __attribute__((format(printf, 1, 2)));
@@ -0,0 +1,111 @@
+#include "BatterySave.h"
+#include "../Definitions.h"
+#include "../Log.h"
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+BatterySave::BatterySave() {
+    this->memory = nullptr;
+    this->size = 0;
+    this->fd = -1;
+    this->pageSize = sysconf(_SC_PAGESIZE);
+    this->stopping = false;
+}
+
+BatterySave::~BatterySave() {
+    if (flusher.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(syncMutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        flusher.join();
+    }
+
+    if (memory != nullptr) {
+        flush();
+        munmap(memory, size);
+        logPrintf(GREEN "BatterySave: Save file closed\n" RESET);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+int BatterySave::open(const char *path, int size) {
+    fd = ::open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        logPrintf(RED "BatterySave: Could not open save file %s\n" RESET, path);
+        return 1;
+    }
+
+    //the mapping is shared with the file, a second emulator on the same save would be writing into the same ram.
+    //whoever locks it first owns it until the cartridge goes, the lock is dropped when fd is closed
+    if (flock(fd, LOCK_EX | LOCK_NB) != 0) {
+        if (errno == EWOULDBLOCK) {
+            logPrintf(YELLOW "BatterySave: %s is owned by another running instance\n" RESET, path);
+        } else {
+            logPrintf(RED "BatterySave: Could not lock save file %s\n" RESET, path);
+        }
+        return 1;
+    }
+
+    //new saves start out as zeros, short ones are padded
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (info.st_size < size && ftruncate(fd, size) != 0)) {
+        logPrintf(RED "BatterySave: Could not size save file %s\n" RESET, path);
+        return 1;
+    }
+
+    void *mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) {
+        logPrintf(RED "BatterySave: Could not map save file %s\n" RESET, path);
+        return 1;
+    }
+    this->memory = (uint8_t *)mapping;
+    this->size = size;
+    flushed.assign(memory, memory + size);
+
+    flusher = std::thread(&BatterySave::flushLoop, this);
+    logPrintf(GREEN "BatterySave: Mapped %s, owned by this instance (pid %d)\n" RESET, path, (int)getpid());
+    return 0;
+}
+
+uint8_t *BatterySave::data() {
+    return memory;
+}
+
+void BatterySave::flush() {
+    std::lock_guard<std::mutex> lock(syncMutex);
+    syncChangedPages();
+}
+
+void BatterySave::flushLoop() {
+    std::unique_lock<std::mutex> lock(syncMutex);
+    while (!stopping) {
+        wake.wait_for(lock, std::chrono::milliseconds(FLUSH_INTERVAL_MS));
+        if (!stopping) {
+            syncChangedPages();
+        }
+    }
+}
+
+void BatterySave::syncChangedPages() {
+    //the copy is taken before the sync so a write landing in between is still seen as a change next time
+    for (int offset = 0; offset < size; offset += pageSize) {
+        int length = std::min<long>(pageSize, size - offset);
+        if (memcmp(memory + offset, flushed.data() + offset, length) == 0) {
+            continue;
+        }
+        memcpy(flushed.data() + offset, memory + offset, length);
+        msync(memory + offset, length, MS_SYNC);
+    }
+}
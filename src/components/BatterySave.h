@@ -0,0 +1,45 @@
+// battery backed PRG-RAM in a memory mapped save file
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+//the emulator writes straight into the mapping through the cpu page table. a background thread compares the
+//mapping against what it last wrote out and msyncs only the pages that differ, so the emulation thread never
+//waits on the file
+class BatterySave {
+public:
+    BatterySave();
+    //stops the flush thread and does a last flush
+    ~BatterySave();
+
+    //maps size bytes of the file at path, creating it if needed, returns 0 on success. fails without touching the
+    //file when another instance holds its lock
+    int open(const char *path, int size);
+    uint8_t *data();
+
+    //syncs every changed page and waits for the writes to finish
+    void flush();
+
+private:
+    static constexpr int FLUSH_INTERVAL_MS = 1000;
+
+    uint8_t *memory;
+    int size;
+    int fd;
+    long pageSize;
+
+    //mapping contents as of the last sync
+    std::vector<uint8_t> flushed;
+
+    std::thread flusher;
+    //held while syncing, flush can be called from the emulation thread while the flusher runs
+    std::mutex syncMutex;
+    std::condition_variable wake;
+    bool stopping;
+
+    void flushLoop();
+    void syncChangedPages();
+};
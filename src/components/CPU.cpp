@@ -1,7 +1,9 @@
 #include "CPU.h"
 #include <stdio.h>
 #include "../Emulator.h"
+#include "../Log.h"
 #include <cstring>
+#include <algorithm>
 #include <nlohmann/json.hpp>
 #include <iostream>
 
@@ -18,6 +20,10 @@ CPU::CPU(Emulator *emulator) {
 
     this-> absolute_address = 0x00;
     this->absolute_data = 0x00;
+    this->operand = 0x0000;
+
+    this->decodeCache.resize(DECODE_RAM_ENTRIES + 0x8000);
+    invalidateDecodeCache();
 
     //link to other parts of the emulator
     this->emulator = emulator;
@@ -28,7 +34,7 @@ CPU::~CPU() {
 }
 
 void CPU::reset() {
-    printf(YELLOW "CPU: Reset\n" RESET);
+    logPrintf(YELLOW "CPU: Reset\n" RESET);
     state.remaining_cycles = 7;
     //reset vector
     state.program_counter = emulator->cpuBusRead(0xFFFC) | (emulator->cpuBusRead(0xFFFD) << 8);
@@ -39,6 +45,7 @@ void CPU::reset() {
     state.stack_pointer = 0xFD;
     state.status_register = 0x20;
     cycleCount = 0;
+    irqLine = 0;
 }
 
 CpuState *CPU::getState() {
@@ -53,14 +60,16 @@ void CPU::setFlag(uint8_t flag, bool value) {
     }
 }
 
-void CPU::pushStack(uint8_t data) {
-    emulator->cpuBusWrite(0x0100 + state.stack_pointer, data);
+__attribute__((always_inline)) inline void CPU::pushStack(uint8_t data) {
+    //stack page is always plain memory
+    emulator->cpuWritePages[0x01][state.stack_pointer] = data;
+    ramWritten(0x0100 + state.stack_pointer);
     state.stack_pointer--;
 }
 
-uint8_t CPU::pullStack() {
+__attribute__((always_inline)) inline uint8_t CPU::pullStack() {
     state.stack_pointer++;
-    return emulator->cpuBusRead(0x0100 + state.stack_pointer);
+    return emulator->cpuReadPages[0x01][state.stack_pointer];
 }
 
 void CPU::updateAbsolute() {
@@ -90,10 +99,26 @@ void CPU::nmi() {
     state.remaining_cycles += 7;    
 }
 
+void CPU::irq() {
+    pushStack((state.program_counter >> 8) & 0xFF);
+    pushStack(state.program_counter & 0xFF);
+
+    setFlag(B_FLAG, false);
+    setFlag(U_FLAG, true);
+    pushStack(state.status_register);
+    setFlag(I_FLAG, true);
+
+    state.program_counter = emulator->cpuBusRead(0xFFFE) | (emulator->cpuBusRead(0xFFFF) << 8);
+
+    state.remaining_cycles += 7;
+}
+
 void CPU::cpuLog(OpcodeInfo opcode) {
     if (emulator->logging == false) {
         return;
     }
+    //log shows where the ppu is
+    emulator->syncPpu();
 
     // //log information for opcode that is about to run, if the log ends here the error occured in that opcode
     char logMessage[250]; 
@@ -133,11 +158,348 @@ void CPU::cpuLog(OpcodeInfo opcode) {
 }
 
 void CPU::runInstruction() {
-    //decode and run opcode at program counter
-    uint8_t opcodeByte = emulator->cpuBusRead(state.program_counter);
-    OpcodeInfo opcode = opcodeTable[opcodeByte >> 4][opcodeByte & 0x0F];
+    //decode and run opcode at program counter, going through the decode cache when the address is cacheable
+    DecodedInstruction *decoded = emulator->TestingMode ? nullptr : decode(state.program_counter);
+    uint8_t opcodeByte;
+    OpcodeHandler handler;
+
+    if (decoded != nullptr) {
+        opcodeByte = decoded->opcodeByte;
+        operand = decoded->operand;
+        handler = decoded->handler;
+    } else {
+        opcodeByte = emulator->cpuBusRead(state.program_counter);
+        operand = readOperand(state.program_counter, opcodeTable[opcodeByte >> 4][opcodeByte & 0x0F].byteCount);
+        handler = handlers[opcodeByte];
+    }
+
+    if (emulator->logging) {
+        cpuLog(opcodeTable[opcodeByte >> 4][opcodeByte & 0x0F]);
+    }
+
+    handler(this, operand);
+
+    cycleCount++;
+    state.remaining_cycles--;
+
+    //tell emulator
+    emulator->instructionCount++;
+}
+
+CPU::DecodedInstruction *CPU::decode(uint16_t address) {
+    //returns the cached decode of the instruction at address, filling the entry on a miss, or nullptr if the address isnt cacheable
+    DecodedInstruction *decoded = lookupDecoded(address);
+    if (decoded == nullptr || decoded->valid) {
+        return decoded;
+    }
+
+    uint8_t opcodeByte = emulator->cpuBusRead(address);
+    const OpcodeInfo &opcode = opcodeTable[opcodeByte >> 4][opcodeByte & 0x0F];
+    *decoded = {handlers[opcodeByte], readOperand(address, opcode.byteCount), opcodeByte, opcode.byteCount, opcode.cycleCount, true};
+
+    if (address < 0x2000) {
+        //remember which ram bytes now back a cached instruction so writes to them can invalidate it
+        for (int i = 0; i < opcode.byteCount; i++) {
+            ramCodeBytes[(address + i) & 0x07FF] = 1;
+        }
+    }
+    return decoded;
+}
+
+uint16_t CPU::readOperand(uint16_t address, uint8_t byteCount) {
+    //up to two bytes following the opcode, little endian
+    uint16_t value = 0;
+    if (byteCount > 1) {
+        value = emulator->cpuBusRead(address + 1);
+    }
+    if (byteCount > 2) {
+        value |= emulator->cpuBusRead(address + 2) << 8;
+    }
+    return value;
+}
+
+CPU::DecodedInstruction *CPU::lookupDecoded(uint16_t address) {
+    //only internal ram and PRG space can hold code worth caching
+    if (address >= 0x8000) {
+        return &decodeCache[DECODE_RAM_ENTRIES + (address - 0x8000)];
+    }
+    if (address < 0x2000) {
+        return &decodeCache[address & 0x07FF];
+    }
+    return nullptr;
+}
+
+void CPU::invalidateRamCode(uint16_t ramAddress) {
+    //an instruction is at most 3 bytes, so only entries starting up to 2 bytes before the write can contain it
+    for (int i = 0; i < 3; i++) {
+        decodeCache[(ramAddress - i) & 0x07FF].valid = false;
+    }
+    ramCodeBytes[ramAddress] = 0;
+}
+
+void CPU::invalidateDecodeCache() {
+    for (DecodedInstruction &decoded : decodeCache) {
+        decoded.valid = false;
+    }
+    memset(ramCodeBytes, 0, sizeof(ramCodeBytes));
+
+    //translated blocks and idle loops are built out of PRG decodes, so they go too
+    blocks.clear();
+    blockLookup.assign(0x8000, BLOCK_NOT_TRANSLATED);
+    blockHeat.assign(0x8000, 0);
+    idleLoopInfo.assign(0x8000, IDLE_LOOP_UNKNOWN);
+    idleHead = 0;
+    idleVisits = 0;
+}
+
+void CPU::invalidatePrgCode(uint16_t start, int end) {
+    //instructions, blocks and idle loops starting a little before the range can still read into it
+    int from = std::max(0x8000, start - (int)MAX_BLOCK_INSTRUCTIONS * 3);
+    for (int address = from; address < end; address++) {
+        int index = address - 0x8000;
+        decodeCache[DECODE_RAM_ENTRIES + index].valid = false;
+        blockLookup[index] = BLOCK_NOT_TRANSLATED;
+        blockHeat[index] = 0;
+        idleLoopInfo[index] = IDLE_LOOP_UNKNOWN;
+    }
+    if (idleHead >= from && idleHead < end) {
+        idleHead = 0;
+        idleVisits = 0;
+    }
+
+    if (blocks.size() > MAX_BLOCKS) {
+        blocks.clear();
+        blockLookup.assign(0x8000, BLOCK_NOT_TRANSLATED);
+    }
+}
+
+//block translation backend
+//hot basic blocks in PRG space are translated once into a list of pre-decoded handlers and then run back to back
+//at the tick the block starts, with the cycles of the whole block accounted for at once. that is only invisible
+//to the rest of the system if nothing in the block can be observed by or observe the PPU, so blocks stop before
+//any access outside of internal ram / PRG reads, and never run past the next NMI or the end of the frame
+
+bool CPU::safeBlockAddress(uint16_t address, bool writes) {
+    //internal ram always, PRG space only for reads since writes there will be mapper registers
+    return address < 0x2000 || (!writes && address >= 0x8000);
+}
+
+bool CPU::endsBlock(const OpcodeInfo &opcode) {
+    //anything that can change control flow ends a block
+    return opcode.AddrMode == &CPU::REL || opcode.OpFunction == &CPU::JMP || opcode.OpFunction == &CPU::JSR ||
+           opcode.OpFunction == &CPU::RTS || opcode.OpFunction == &CPU::RTI || opcode.OpFunction == &CPU::BRK ||
+           opcode.OpFunction == &CPU::XXX;
+}
+
+bool CPU::writesMemory(const OpcodeInfo &opcode) {
+    if (opcode.OpFunction == &CPU::STA || opcode.OpFunction == &CPU::STX || opcode.OpFunction == &CPU::STY ||
+        opcode.OpFunction == &CPU::SAX || opcode.OpFunction == &CPU::SHA || opcode.OpFunction == &CPU::TAS ||
+        opcode.OpFunction == &CPU::SHY || opcode.OpFunction == &CPU::SHX) {
+        return true;
+    }
+    //read modify write opcodes, unless they work on the accumulator
+    if (opcode.AddrMode == &CPU::ACC) {
+        return false;
+    }
+    return opcode.OpFunction == &CPU::ASL || opcode.OpFunction == &CPU::LSR || opcode.OpFunction == &CPU::ROL ||
+           opcode.OpFunction == &CPU::ROR || opcode.OpFunction == &CPU::INC || opcode.OpFunction == &CPU::DEC ||
+           opcode.OpFunction == &CPU::SLO || opcode.OpFunction == &CPU::RLA || opcode.OpFunction == &CPU::SRE ||
+           opcode.OpFunction == &CPU::RRA || opcode.OpFunction == &CPU::DCP || opcode.OpFunction == &CPU::ISC;
+}
+
+void CPU::translateBlock(uint16_t address) {
+    TranslatedBlock block;
+    uint16_t pc = address;
+
+    while (block.instructions.size() < MAX_BLOCK_INSTRUCTIONS && pc >= 0x8000) {
+        DecodedInstruction *decoded = decode(pc);
+        const OpcodeInfo &opcode = opcodeTable[decoded->opcodeByte >> 4][decoded->opcodeByte & 0x0F];
+        BlockInstruction instruction = {*decoded, BLOCK_ACCESS_NONE, writesMemory(opcode)};
+
+        //addresses known now are checked once here, indexed and indirect ones are checked before every run
+        if (opcode.AddrMode == &CPU::ABS) {
+            if (!safeBlockAddress(decoded->operand, instruction.writes)) break;
+        } else if (opcode.AddrMode == &CPU::ABSX) {
+            instruction.access = BLOCK_ACCESS_INDEXED_X;
+        } else if (opcode.AddrMode == &CPU::ABSY) {
+            instruction.access = BLOCK_ACCESS_INDEXED_Y;
+        } else if (opcode.AddrMode == &CPU::XIND) {
+            instruction.access = BLOCK_ACCESS_INDIRECT_X;
+        } else if (opcode.AddrMode == &CPU::INDY) {
+            instruction.access = BLOCK_ACCESS_INDIRECT_Y;
+        } else if (opcode.AddrMode == &CPU::IND) {
+            instruction.access = BLOCK_ACCESS_INDIRECT;
+        }
+
+        block.instructions.push_back(instruction);
+        if (endsBlock(opcode)) break;
+        pc += opcode.byteCount;
+    }
+
+    if (block.instructions.empty()) {
+        //first instruction already needs the PPU, leave this address to the interpreter
+        blockLookup[address - 0x8000] = BLOCK_UNTRANSLATABLE;
+        return;
+    }
+
+    blockLookup[address - 0x8000] = blocks.size();
+    blocks.push_back(block);
+    blocksTranslated++;
+}
+
+bool CPU::blockAccessSafe(const BlockInstruction &instruction) {
+    //effective address of the instruction with the current registers, without any of the side effects
+    uint16_t address = 0;
+    uint16_t pointer;
+    switch (instruction.access) {
+        case BLOCK_ACCESS_NONE:
+            return true;
+        case BLOCK_ACCESS_INDEXED_X:
+            address = instruction.decoded.operand + state.x_register;
+            break;
+        case BLOCK_ACCESS_INDEXED_Y:
+            address = instruction.decoded.operand + state.y_register;
+            break;
+        case BLOCK_ACCESS_INDIRECT_X:
+            pointer = (instruction.decoded.operand + state.x_register) & 0xFF;
+            address = (emulator->cpuBusRead((pointer + 1) & 0xFF) << 8) | emulator->cpuBusRead(pointer);
+            break;
+        case BLOCK_ACCESS_INDIRECT_Y:
+            pointer = instruction.decoded.operand & 0xFF;
+            address = ((emulator->cpuBusRead((pointer + 1) & 0xFF) << 8) | emulator->cpuBusRead(pointer)) + state.y_register;
+            break;
+        case BLOCK_ACCESS_INDIRECT:
+            //the pointer itself has to be safe to read before the target can be worked out
+            pointer = instruction.decoded.operand;
+            if (!safeBlockAddress(pointer, false) || !safeBlockAddress((pointer & 0xFF00) | ((pointer + 1) & 0x00FF), false)) {
+                return false;
+            }
+            address = (emulator->cpuBusRead((pointer & 0xFF00) | ((pointer + 1) & 0x00FF)) << 8) | emulator->cpuBusRead(pointer);
+            break;
+    }
+    return safeBlockAddress(address, instruction.writes);
+}
+
+bool CPU::runBlock() {
+    //returns false when the interpreter should run the next instruction instead
+
+    //instruction stepping, logging and the reference core all need to see every instruction
+    //a held IRQ line has to be looked at between every instruction, a CLI in the block would otherwise be missed
+    if (emulator->stepping || emulator->logging || emulator->TestingMode || referenceCore || irqLine || state.program_counter < 0x8000) {
+        return false;
+    }
+
+    int index = state.program_counter - 0x8000;
+    if (blockLookup[index] == BLOCK_NOT_TRANSLATED) {
+        if (blockHeat[index] < BLOCK_HOT_THRESHOLD) {
+            blockHeat[index]++;
+            return false;
+        }
+        translateBlock(state.program_counter);
+    }
+    if (blockLookup[index] == BLOCK_UNTRANSLATABLE) {
+        return false;
+    }
+
+    const TranslatedBlock &block = blocks[blockLookup[index]];
+
+    //the block runs now, so every instruction in it has to start before the PPU next does something the cpu can see
+    int dotBudget = emulator->dotsUntilPpuEvent();
+
+    BlockSnapshot before;
+    if (blockCrossCheck) {
+        takeBlockSnapshot(before);
+    }
+
+    int executed = 0;
+    for (const BlockInstruction &instruction : block.instructions) {
+        //remaining cycles holds every cycle used by the block so far, which is when this instruction would start
+        if (executed > 0 && 3 * state.remaining_cycles > dotBudget) break;
+        if (!blockAccessSafe(instruction)) break;
+
+        instruction.decoded.handler(this, instruction.decoded.operand);
+        executed++;
+    }
+
+    if (executed == 0) {
+        return false;
+    }
+
+    if (blockCrossCheck) {
+        crossCheckBlock(before, executed);
+    }
+
+    //same bookkeeping runInstruction does, once for the whole block
+    cycleCount++;
+    state.remaining_cycles--;
+    emulator->instructionCount += executed;
+    return true;
+}
+
+void CPU::takeBlockSnapshot(BlockSnapshot &snapshot) {
+    snapshot.state = state;
+    snapshot.absolute_address = absolute_address;
+    snapshot.absolute_data = absolute_data;
+    for (int i = 0; i < 0x0800; i++) {
+        snapshot.ram[i] = emulator->cpuBusRead(i);
+    }
+}
+
+void CPU::crossCheckBlock(const BlockSnapshot &before, int executed) {
+    //rewinds to before the block, replays the same instructions through the reference interpreter and compares
+    BlockSnapshot translated;
+    takeBlockSnapshot(translated);
+
+    state = before.state;
+    absolute_address = before.absolute_address;
+    absolute_data = before.absolute_data;
+    for (int i = 0; i < 0x0800; i++) {
+        if (translated.ram[i] != before.ram[i]) {
+            emulator->cpuBusWrite(i, before.ram[i]);
+        }
+    }
+
+    for (int i = 0; i < executed; i++) {
+        uint8_t opcodeByte = emulator->cpuBusRead(state.program_counter);
+        operand = readOperand(state.program_counter, opcodeTable[opcodeByte >> 4][opcodeByte & 0x0F].byteCount);
+        executeReference(opcodeByte);
+    }
+
+    BlockSnapshot interpreted;
+    takeBlockSnapshot(interpreted);
+
+    bool match = memcmp(translated.ram, interpreted.ram, sizeof(translated.ram)) == 0 &&
+                 translated.state.accumulator == state.accumulator && translated.state.x_register == state.x_register &&
+                 translated.state.y_register == state.y_register && translated.state.program_counter == state.program_counter &&
+                 translated.state.stack_pointer == state.stack_pointer && translated.state.status_register == state.status_register &&
+                 translated.state.remaining_cycles == state.remaining_cycles;
+
+    if (!match) {
+        blockMismatches++;
+        logPrintf(RED "CPU: Block at 0x%04X (%i instructions) differs from interpreter, PC 0x%04X vs 0x%04X, A %02X vs %02X, P %02X vs %02X, cycles %i vs %i\n" RESET,
+               before.state.program_counter, executed, translated.state.program_counter, state.program_counter, translated.state.accumulator,
+               state.accumulator, translated.state.status_register, state.status_register, translated.state.remaining_cycles, state.remaining_cycles);
+    }
+    //interpreter result is the one that is kept
+}
+
+void CPU::execute(uint8_t opcodeByte) {
+    handlers[opcodeByte](this, operand);
+}
+
+void CPU::setReferenceCore(bool enabled) {
+    referenceCore = enabled;
+    handlers = enabled ? referenceTable.data() : dispatchTable.data();
+    //cached decodes hold a handler from the old table
+    invalidateDecodeCache();
+}
+
+bool CPU::getReferenceCore() {
+    return referenceCore;
+}
 
-    cpuLog(opcode);
+void CPU::executeReference(uint8_t opcodeByte) {
+    OpcodeInfo opcode = opcodeTable[opcodeByte >> 4][opcodeByte & 0x0F];
 
     //add cycle counts to remaining cycles
     state.remaining_cycles += opcode.cycleCount;
@@ -157,25 +519,525 @@ void CPU::runInstruction() {
     }
     extraCycleCheck = 0;
 
-    cycleCount++;
-    state.remaining_cycles--;
-
     //ensure accumulator mode is reset, because the opcodes dont reset it and they need to know
     accumulatorMode = false;
+}
 
-    //tell emulator
-    emulator->instructionCount++;
+template <uint8_t opcodeByte>
+void CPU::executeOpcode(CPU *cpu, uint16_t operand) {
+    //same bus accesses and results as executeReference, with the table entry a constant
+    constexpr OpcodeInfo opcode = opcodeTable[opcodeByte >> 4][opcodeByte & 0x0F];
+    constexpr auto mode = opcode.AddrMode;
+    constexpr auto operation = opcode.OpFunction;
+    //read operations take an extra cycle when indexing crosses a page
+    constexpr bool pageCycle = operation == &CPU::ADC || operation == &CPU::SBC || operation == &CPU::USBC ||
+        operation == &CPU::AND || operation == &CPU::ORA || operation == &CPU::EOR || operation == &CPU::CMP ||
+        operation == &CPU::LDA || operation == &CPU::LDX || operation == &CPU::LDY || operation == &CPU::LAX ||
+        operation == &CPU::LAS || operation == &CPU::NOPE;
+
+    cpu->state.remaining_cycles += opcode.cycleCount;
+    uint16_t address = cpu->effectiveAddress<mode, pageCycle>(operand);
+
+    //the reference reads the effective address before every operation, stores and implied opcodes included, and
+    //reads of io registers have side effects so that stays. branch and jump targets are code and are not read
+    uint8_t value = 0;
+    if constexpr (mode == &CPU::ACC) {
+        value = cpu->state.accumulator;
+    } else if constexpr (mode == &CPU::IMM) {
+        value = operand & 0xFF;
+    } else if constexpr (mode != &CPU::REL && operation != &CPU::JMP && operation != &CPU::JSR) {
+        value = cpu->emulator->cpuBusRead(address);
+    }
+    cpu->operate<mode, operation>(address, value);
+}
+
+template <void (CPU::*mode)(), bool pageCycle>
+__attribute__((always_inline)) inline uint16_t CPU::effectiveAddress(uint16_t operand) {
+    //moves the program counter past the instruction and returns the address it works on, like the mode functions
+    uint16_t pc = state.program_counter;
+    uint16_t address;
+    if constexpr (mode == &CPU::IMPL || mode == &CPU::ACC) {
+        state.program_counter = pc + 1;
+        return absolute_address;
+    } else if constexpr (mode == &CPU::XXX) {
+        //jams dont move
+        return absolute_address;
+    } else if constexpr (mode == &CPU::IMM) {
+        state.program_counter = pc + 2;
+        address = pc + 1;
+    } else if constexpr (mode == &CPU::REL) {
+        state.program_counter = pc + 2;
+        address = state.program_counter + (int8_t)(operand & 0xFF);
+    } else if constexpr (mode == &CPU::ZPG) {
+        state.program_counter = pc + 2;
+        address = operand & 0xFF;
+    } else if constexpr (mode == &CPU::ZPGX) {
+        state.program_counter = pc + 2;
+        address = (operand + state.x_register) & 0xFF;
+    } else if constexpr (mode == &CPU::ZPGY) {
+        state.program_counter = pc + 2;
+        address = (operand + state.y_register) & 0xFF;
+    } else if constexpr (mode == &CPU::ABS) {
+        state.program_counter = pc + 3;
+        address = operand;
+    } else if constexpr (mode == &CPU::ABSX || mode == &CPU::ABSY) {
+        state.program_counter = pc + 3;
+        address = operand + (mode == &CPU::ABSX ? state.x_register : state.y_register);
+        if (pageCycle && (address & 0xFF00) != (operand & 0xFF00)) {
+            state.remaining_cycles++;
+        }
+    } else if constexpr (mode == &CPU::IND) {
+        //the pointer wraps inside its page
+        state.program_counter = pc + 3;
+        uint16_t high = (operand & 0x00FF) == 0x00FF ? (operand & 0xFF00) : operand + 1;
+        address = (emulator->cpuBusRead(high) << 8) | emulator->cpuBusRead(operand);
+    } else if constexpr (mode == &CPU::XIND) {
+        state.program_counter = pc + 2;
+        uint8_t pointer = operand + state.x_register;
+        address = (emulator->cpuBusRead((uint8_t)(pointer + 1)) << 8) | emulator->cpuBusRead(pointer);
+    } else if constexpr (mode == &CPU::INDY) {
+        state.program_counter = pc + 2;
+        uint8_t pointer = operand;
+        uint16_t base = (emulator->cpuBusRead((uint8_t)(pointer + 1)) << 8) | emulator->cpuBusRead(pointer);
+        address = base + state.y_register;
+        if (pageCycle && (address & 0xFF00) != (base & 0xFF00)) {
+            state.remaining_cycles++;
+        }
+    }
+    absolute_address = address;
+    return address;
+}
+
+__attribute__((always_inline)) inline void CPU::setZeroNegative(uint8_t value) {
+    state.status_register = (state.status_register & ~(Z_FLAG | N_FLAG)) | (value == 0 ? Z_FLAG : 0) | (value & N_FLAG);
+}
+
+__attribute__((always_inline)) inline void CPU::addWithCarry(uint8_t value) {
+    uint16_t result = state.accumulator + value + (state.status_register & C_FLAG);
+    setFlag(C_FLAG, result > 0xFF);
+    setFlag(V_FLAG, (~(state.accumulator ^ value) & (state.accumulator ^ result)) & 0x80);
+    state.accumulator = result & 0xFF;
+    setZeroNegative(state.accumulator);
+}
+
+__attribute__((always_inline)) inline void CPU::compare(uint8_t reg, uint8_t value) {
+    setFlag(C_FLAG, reg >= value);
+    setZeroNegative(reg - value);
 }
 
+__attribute__((always_inline)) inline void CPU::branch(bool taken, uint16_t target) {
+    if (taken) {
+        if ((state.program_counter & 0xFF00) != (target & 0xFF00)) {
+            state.remaining_cycles++;
+        }
+        state.program_counter = target;
+        state.remaining_cycles++;
+    }
+}
+
+__attribute__((always_inline)) inline uint8_t CPU::writeBack(uint16_t address, uint8_t result) {
+    //read modify write opcodes in the reference take their flags from reading the result back
+    emulator->cpuBusWrite(address, result);
+    return emulator->cpuBusRead(address);
+}
+
+template <void (CPU::*mode)(), void (CPU::*operation)()>
+__attribute__((always_inline)) inline void CPU::operate(uint16_t address, uint8_t value) {
+    //the opcode functions further down, given their address and operand byte instead of reading members
+    constexpr bool accumulator = mode == &CPU::ACC;
+    uint8_t &a = state.accumulator;
+    uint8_t &x = state.x_register;
+    uint8_t &y = state.y_register;
+    uint8_t &p = state.status_register;
+
+    //loads and logic
+    if constexpr (operation == &CPU::LDA) {
+        a = value;
+        setZeroNegative(a);
+    } else if constexpr (operation == &CPU::LDX) {
+        x = value;
+        setZeroNegative(x);
+    } else if constexpr (operation == &CPU::LDY) {
+        y = value;
+        setZeroNegative(y);
+    } else if constexpr (operation == &CPU::LAX) {
+        a = x = value;
+        setZeroNegative(value);
+    } else if constexpr (operation == &CPU::LAS) {
+        a = x = state.stack_pointer = value & state.stack_pointer;
+        setZeroNegative(a);
+    } else if constexpr (operation == &CPU::AND) {
+        a &= value;
+        setZeroNegative(a);
+    } else if constexpr (operation == &CPU::ORA) {
+        a |= value;
+        setZeroNegative(a);
+    } else if constexpr (operation == &CPU::EOR) {
+        a ^= value;
+        setZeroNegative(a);
+    } else if constexpr (operation == &CPU::BIT) {
+        p = (p & ~(Z_FLAG | N_FLAG | V_FLAG)) | ((value & a) == 0 ? Z_FLAG : 0) | (value & (N_FLAG | V_FLAG));
+    } else if constexpr (operation == &CPU::ANC) {
+        a &= value;
+        setZeroNegative(a);
+        setFlag(C_FLAG, a & 0x80);
+    } else if constexpr (operation == &CPU::ANE) {
+        a = (a | 0xEE) & x & value;
+        setZeroNegative(a);
+
+    //arithmetic
+    } else if constexpr (operation == &CPU::ADC) {
+        addWithCarry(value);
+    } else if constexpr (operation == &CPU::SBC || operation == &CPU::USBC) {
+        addWithCarry(~value);
+    } else if constexpr (operation == &CPU::CMP) {
+        compare(a, value);
+    } else if constexpr (operation == &CPU::CPX) {
+        compare(x, value);
+    } else if constexpr (operation == &CPU::CPY) {
+        compare(y, value);
+    } else if constexpr (operation == &CPU::SBX) {
+        uint8_t base = a & x;
+        x = base - value;
+        setFlag(C_FLAG, base >= value);
+        setZeroNegative(x);
+    } else if constexpr (operation == &CPU::ALR) {
+        a &= value;
+        setFlag(C_FLAG, a & 0x01);
+        a >>= 1;
+        setZeroNegative(a);
+    } else if constexpr (operation == &CPU::ARR) {
+        a = ((a & value) >> 1) | ((p & C_FLAG) << 7);
+        setZeroNegative(a);
+        setFlag(C_FLAG, a & 0x40);
+        setFlag(V_FLAG, (a & 0x40) ^ ((a & 0x20) << 1));
+
+    //shifts, on the accumulator or read modify write
+    } else if constexpr (operation == &CPU::ASL && accumulator) {
+        setFlag(C_FLAG, a & 0x80);
+        a <<= 1;
+        setZeroNegative(a);
+    } else if constexpr (operation == &CPU::LSR && accumulator) {
+        setFlag(C_FLAG, a & 0x01);
+        a >>= 1;
+        setZeroNegative(a);
+    } else if constexpr (operation == &CPU::ROL && accumulator) {
+        uint8_t carry = p & C_FLAG;
+        setFlag(C_FLAG, a & 0x80);
+        a = (a << 1) | carry;
+        setZeroNegative(a);
+    } else if constexpr (operation == &CPU::ROR && accumulator) {
+        uint8_t rotation = (a >> 1) | ((p & C_FLAG) << 7);
+        setFlag(C_FLAG, a & 0x01);
+        a = rotation;
+        setZeroNegative(a);
+    } else if constexpr (operation == &CPU::ASL || operation == &CPU::SLO) {
+        setFlag(C_FLAG, value & 0x80);
+        setZeroNegative(writeBack(address, value << 1));
+        if constexpr (operation == &CPU::SLO) {
+            a |= emulator->cpuBusRead(address);
+            setZeroNegative(a);
+        }
+    } else if constexpr (operation == &CPU::LSR || operation == &CPU::SRE) {
+        setFlag(C_FLAG, value & 0x01);
+        setZeroNegative(writeBack(address, value >> 1));
+        if constexpr (operation == &CPU::SRE) {
+            a ^= emulator->cpuBusRead(address);
+            setZeroNegative(a);
+        }
+    } else if constexpr (operation == &CPU::ROL || operation == &CPU::RLA) {
+        uint8_t carry = p & C_FLAG;
+        setFlag(C_FLAG, value & 0x80);
+        setZeroNegative(writeBack(address, (value << 1) | carry));
+        if constexpr (operation == &CPU::RLA) {
+            a &= emulator->cpuBusRead(address);
+            setZeroNegative(a);
+        }
+    } else if constexpr (operation == &CPU::ROR || operation == &CPU::RRA) {
+        uint8_t rotation = (value >> 1) | ((p & C_FLAG) << 7);
+        setFlag(C_FLAG, value & 0x01);
+        emulator->cpuBusWrite(address, rotation);
+        setZeroNegative(rotation);
+        if constexpr (operation == &CPU::RRA) {
+            addWithCarry(emulator->cpuBusRead(address));
+        }
+    } else if constexpr (operation == &CPU::INC || operation == &CPU::ISC) {
+        setZeroNegative(writeBack(address, value + 1));
+        if constexpr (operation == &CPU::ISC) {
+            addWithCarry(~emulator->cpuBusRead(address));
+        }
+    } else if constexpr (operation == &CPU::DEC || operation == &CPU::DCP) {
+        setZeroNegative(writeBack(address, value - 1));
+        if constexpr (operation == &CPU::DCP) {
+            compare(a, emulator->cpuBusRead(address));
+        }
+
+    //stores
+    } else if constexpr (operation == &CPU::STA) {
+        emulator->cpuBusWrite(address, a);
+    } else if constexpr (operation == &CPU::STX) {
+        emulator->cpuBusWrite(address, x);
+    } else if constexpr (operation == &CPU::STY) {
+        emulator->cpuBusWrite(address, y);
+    } else if constexpr (operation == &CPU::SAX) {
+        emulator->cpuBusWrite(address, a & x);
+
+    //branches and jumps
+    } else if constexpr (operation == &CPU::BCC) {
+        branch(!(p & C_FLAG), address);
+    } else if constexpr (operation == &CPU::BCS) {
+        branch(p & C_FLAG, address);
+    } else if constexpr (operation == &CPU::BNE) {
+        branch(!(p & Z_FLAG), address);
+    } else if constexpr (operation == &CPU::BEQ) {
+        branch(p & Z_FLAG, address);
+    } else if constexpr (operation == &CPU::BPL) {
+        branch(!(p & N_FLAG), address);
+    } else if constexpr (operation == &CPU::BMI) {
+        branch(p & N_FLAG, address);
+    } else if constexpr (operation == &CPU::BVC) {
+        branch(!(p & V_FLAG), address);
+    } else if constexpr (operation == &CPU::BVS) {
+        branch(p & V_FLAG, address);
+    } else if constexpr (operation == &CPU::JMP) {
+        state.program_counter = address;
+    } else if constexpr (operation == &CPU::JSR) {
+        //return address is the last byte of the JSR, the high byte of the target is read after the pushes
+        uint16_t last = state.program_counter - 1;
+        pushStack(last >> 8);
+        pushStack(last & 0xFF);
+        state.program_counter = (address & 0x00FF) | (emulator->cpuBusRead(last) << 8);
+    } else if constexpr (operation == &CPU::RTS) {
+        uint16_t low = pullStack();
+        state.program_counter = (low | (pullStack() << 8)) + 1;
+    } else if constexpr (operation == &CPU::RTI) {
+        p = (pullStack() & ~B_FLAG) | U_FLAG;
+        uint16_t low = pullStack();
+        state.program_counter = low | (pullStack() << 8);
+    } else if constexpr (operation == &CPU::BRK) {
+        //skips the break mark byte
+        state.program_counter++;
+        pushStack(state.program_counter >> 8);
+        pushStack(state.program_counter & 0xFF);
+        pushStack(p | 0x30);
+        p |= I_FLAG;
+        state.program_counter = emulator->cpuBusRead(0xFFFE) | (emulator->cpuBusRead(0xFFFF) << 8);
+
+    //stack, flags and registers
+    } else if constexpr (operation == &CPU::PHA) {
+        pushStack(a);
+    } else if constexpr (operation == &CPU::PHP) {
+        pushStack(p | B_FLAG | U_FLAG);
+    } else if constexpr (operation == &CPU::PLA) {
+        a = pullStack();
+        setZeroNegative(a);
+    } else if constexpr (operation == &CPU::PLP) {
+        p = (pullStack() & ~B_FLAG) | U_FLAG;
+    } else if constexpr (operation == &CPU::CLC) {
+        p &= ~C_FLAG;
+    } else if constexpr (operation == &CPU::SEC) {
+        p |= C_FLAG;
+    } else if constexpr (operation == &CPU::CLD) {
+        p &= ~D_FLAG;
+    } else if constexpr (operation == &CPU::SED) {
+        p |= D_FLAG;
+    } else if constexpr (operation == &CPU::CLI) {
+        p &= ~I_FLAG;
+    } else if constexpr (operation == &CPU::SEI) {
+        p |= I_FLAG;
+    } else if constexpr (operation == &CPU::CLV) {
+        p &= ~V_FLAG;
+    } else if constexpr (operation == &CPU::TAX) {
+        x = a;
+        setZeroNegative(x);
+    } else if constexpr (operation == &CPU::TAY) {
+        y = a;
+        setZeroNegative(y);
+    } else if constexpr (operation == &CPU::TXA) {
+        a = x;
+        setZeroNegative(a);
+    } else if constexpr (operation == &CPU::TYA) {
+        a = y;
+        setZeroNegative(a);
+    } else if constexpr (operation == &CPU::TSX) {
+        x = state.stack_pointer;
+        setZeroNegative(x);
+    } else if constexpr (operation == &CPU::TXS) {
+        state.stack_pointer = x;
+    } else if constexpr (operation == &CPU::INX) {
+        setZeroNegative(++x);
+    } else if constexpr (operation == &CPU::INY) {
+        setZeroNegative(++y);
+    } else if constexpr (operation == &CPU::DEX) {
+        setZeroNegative(--x);
+    } else if constexpr (operation == &CPU::DEY) {
+        setZeroNegative(--y);
+    } else {
+        //NOP, JAM and the unstable SHA, TAS, SHY, SHX and LXA do nothing past the read
+        static_assert(operation == &CPU::NOP || operation == &CPU::NOPE || operation == &CPU::XXX || operation == &CPU::SHA ||
+            operation == &CPU::TAS || operation == &CPU::SHY || operation == &CPU::SHX || operation == &CPU::LXA, "opcode without a fused body");
+        (void)address;
+        (void)value;
+    }
+}
+
+template <uint8_t opcodeByte>
+void CPU::referenceOpcode(CPU *cpu, uint16_t operand) {
+    cpu->operand = operand;
+    cpu->executeReference(opcodeByte);
+}
+
+template <bool reference, std::size_t... opcodeBytes>
+constexpr std::array<CPU::OpcodeHandler, 256> CPU::buildDispatchTable(std::index_sequence<opcodeBytes...>) {
+    if constexpr (reference) {
+        return {{&CPU::referenceOpcode<opcodeBytes>...}};
+    } else {
+        return {{&CPU::executeOpcode<opcodeBytes>...}};
+    }
+}
+
+const std::array<CPU::OpcodeHandler, 256> CPU::dispatchTable = CPU::buildDispatchTable<false>(std::make_index_sequence<256>());
+const std::array<CPU::OpcodeHandler, 256> CPU::referenceTable = CPU::buildDispatchTable<true>(std::make_index_sequence<256>());
+
 void CPU::clock() {
+    if (idleCycles > 0) {
+        //fast forwarded passes of an idle loop
+        idleCycles--;
+        cycleCount++;
+        return;
+    }
     if (state.remaining_cycles == 0) {
-        runInstruction();
+        if (irqLine && !(state.status_register & I_FLAG)) {
+            //first of the 7 cycles of the interrupt sequence
+            irq();
+            state.remaining_cycles--;
+            cycleCount++;
+            return;
+        }
+        if (idleSkip && skipIdleLoop()) {
+            return;
+        }
+        uint16_t previousPC = state.program_counter;
+        if (!(blockBackend && runBlock())) {
+            runInstruction();
+        }
+        if (idleSkip) {
+            trackIdleLoop(previousPC);
+        }
     } else {
         state.remaining_cycles--;
         cycleCount++;
     }
 }
 
+void CPU::skipCycles(int count) {
+    cycleCount += count;
+    if (idleCycles > 0) {
+        idleCycles -= count;
+        return;
+    }
+    state.remaining_cycles -= count;
+}
+
+//idle loop detection
+//games mostly wait for the NMI in a short loop that only reads ram or rom and jumps back to its start. once a
+//pass leaves every register exactly as the previous pass did, all further passes are identical until an interrupt
+//changes something, so whole passes up to the PPU's next event can be counted instead of run
+
+uint8_t CPU::idleLoopLength(uint16_t head) {
+    //instructions in the loop starting at head, or 0 if it isnt a side effect free polling loop
+    uint8_t &info = idleLoopInfo[head - 0x8000];
+    if (info != IDLE_LOOP_UNKNOWN) {
+        return info == IDLE_LOOP_NONE ? 0 : info;
+    }
+    info = IDLE_LOOP_NONE;
+
+    uint16_t pc = head;
+    for (uint8_t length = 1; length <= MAX_IDLE_LOOP_INSTRUCTIONS && pc >= 0x8000; length++) {
+        DecodedInstruction *decoded = decode(pc);
+        const OpcodeInfo &opcode = opcodeTable[decoded->opcodeByte >> 4][decoded->opcodeByte & 0x0F];
+
+        if (endsBlock(opcode)) {
+            //has to be the jump back to the start, branches fall through when they stop looping
+            bool branchBack = opcode.AddrMode == &CPU::REL && (uint16_t)(pc + 2 + (int8_t)(decoded->operand & 0xFF)) == head;
+            bool jumpBack = opcode.OpFunction == &CPU::JMP && opcode.AddrMode == &CPU::ABS && decoded->operand == head;
+            if (branchBack || jumpBack) {
+                info = length;
+            }
+            return info == IDLE_LOOP_NONE ? 0 : info;
+        }
+
+        //nothing that writes, touches the stack or could reach the PPU / io registers
+        if (writesMemory(opcode) || opcode.OpFunction == &CPU::PHA || opcode.OpFunction == &CPU::PHP ||
+            opcode.OpFunction == &CPU::PLA || opcode.OpFunction == &CPU::PLP) {
+            return 0;
+        }
+        if (opcode.AddrMode == &CPU::ABS && !safeBlockAddress(decoded->operand, false)) {
+            return 0;
+        }
+        if (opcode.AddrMode == &CPU::ABSX || opcode.AddrMode == &CPU::ABSY || opcode.AddrMode == &CPU::XIND ||
+            opcode.AddrMode == &CPU::INDY || opcode.AddrMode == &CPU::IND) {
+            return 0;
+        }
+        pc += opcode.byteCount;
+    }
+    return 0;
+}
+
+void CPU::trackIdleLoop(uint16_t previousPC) {
+    //a short jump backwards is the only way into a polling loop
+    uint16_t pc = state.program_counter;
+    if (pc == idleHead || pc > previousPC || previousPC - pc > 32 || pc < 0x8000) {
+        return;
+    }
+    if (idleLoopLength(pc) > 0) {
+        idleHead = pc;
+        idleVisits = 0;
+    }
+}
+
+bool CPU::skipIdleLoop() {
+    if (state.program_counter != idleHead || emulator->stepping || emulator->logging || emulator->TestingMode || irqLine) {
+        return false;
+    }
+
+    bool sameRegisters = idleVisits > 0 && idleState.accumulator == state.accumulator && idleState.x_register == state.x_register &&
+                         idleState.y_register == state.y_register && idleState.stack_pointer == state.stack_pointer &&
+                         idleState.status_register == state.status_register;
+    int period = cycleCount - idleVisitCycle;
+
+    if (!sameRegisters || (idleVisits > 1 && period != idlePeriod)) {
+        //start over from this pass
+        idleVisits = 1;
+        idleState = state;
+        idleVisitCycle = cycleCount;
+        return false;
+    }
+    if (idleVisits == 1) {
+        //second visit gives the length of a pass, a third one has to agree before anything is skipped
+        idlePeriod = period;
+        idleVisits = 2;
+        idleVisitCycle = cycleCount;
+        return false;
+    }
+
+    //the pass that the next event lands in still has to run normally, so stop a full pass before it
+    int passes = emulator->dotsUntilPpuEvent() / (3 * idlePeriod) - 1;
+    if (passes < 1) {
+        idleVisitCycle = cycleCount;
+        return false;
+    }
+
+    idleCycles = passes * idlePeriod - 1;
+    cycleCount++;
+    emulator->instructionCount += passes * idleLoopLength(idleHead);
+    idleCyclesSkipped += passes * idlePeriod;
+
+    //next visit lands exactly one period after this fake previous visit
+    idleVisitCycle = cycleCount - 1 + (passes - 1) * idlePeriod;
+    return true;
+}
+
 //keep at bottom, cpu addressing modes and opcodes
 
 //addressing modes, assume that the program counter is on the proceeding opcode by the end unless said otherwise
@@ -190,7 +1052,7 @@ void CPU::IMPL() {
 void CPU::REL() {
     //relative
     state.program_counter++;
-    int8_t offset = emulator->cpuBusRead(state.program_counter);
+    int8_t offset = operand & 0xFF;
     state.program_counter++; //end of current instruction
     absolute_address = state.program_counter + offset; //branch instructions will branhc here sometimes, check their function
 
@@ -202,7 +1064,7 @@ void CPU::REL() {
 void CPU::ABS() {
     //absolute, full address is provided
     state.program_counter++;
-    absolute_address = (emulator->cpuBusRead(state.program_counter + 1) << 8) | emulator->cpuBusRead(state.program_counter);
+    absolute_address = operand;
     state.program_counter += 2;
 }
 
@@ -215,7 +1077,7 @@ void CPU::IMM() {
 void CPU::XIND() {
     //X-indexed, indirect
     state.program_counter++;
-    uint16_t baseIndex = emulator->cpuBusRead(state.program_counter);
+    uint16_t baseIndex = operand & 0xFF;
 	absolute_address = (emulator->cpuBusRead((baseIndex + state.x_register + 1) & 0xFF) << 8) | emulator->cpuBusRead((baseIndex + state.x_register) & 0xFF);
 	state.program_counter++;
 }
@@ -223,11 +1085,12 @@ void CPU::XIND() {
 void CPU::INDY() {
     //indirect, Y-indexed
     state.program_counter++;
-    uint16_t baseIndex = emulator->cpuBusRead(state.program_counter);
-	absolute_address = ((emulator->cpuBusRead((baseIndex + 1) & 0xFF) << 8) | emulator->cpuBusRead((baseIndex) & 0xFF)) + state.y_register;
+    uint16_t baseIndex = operand & 0xFF;
+    uint16_t pointer = (emulator->cpuBusRead((baseIndex + 1) & 0xFF) << 8) | emulator->cpuBusRead((baseIndex) & 0xFF);
+	absolute_address = pointer + state.y_register;
 	state.program_counter++;
 
-    if ((absolute_address & 0xFF00) != (emulator->cpuBusRead((baseIndex + 1) & 0xFF) << 8)) {
+    if ((absolute_address & 0xFF00) != (pointer & 0xFF00)) {
         extraCycleCheck++;
     }
 }
@@ -235,21 +1098,21 @@ void CPU::INDY() {
 void CPU::ZPG() {
     //zeropage
     state.program_counter++;
-    absolute_address = emulator->cpuBusRead(state.program_counter);
+    absolute_address = operand & 0xFF;
     state.program_counter++;
 }
 
 void CPU::ZPGX() {
     //zeropage x-indexed
     state.program_counter++;
-    absolute_address = (emulator->cpuBusRead(state.program_counter) + state.x_register) & 0xFF;
+    absolute_address = (operand + state.x_register) & 0xFF;
     state.program_counter++;
 }
 
 void CPU::ZPGY() {
     //zeropage y-indexed
     state.program_counter++;
-    absolute_address= (emulator->cpuBusRead(state.program_counter) + state.y_register) & 0xFF;
+    absolute_address = (operand + state.y_register) & 0xFF;
     state.program_counter++;
 }
 
@@ -975,7 +1838,6 @@ void CPU::testOpcodes() {
         }
 
         accumulatorMode = false;
-        OpcodeInfo opcode = opcodeTable[t >> 4][t & 0x0F];
 
         //open file with tests for this opcode
         char filename[36];
@@ -1016,11 +1878,9 @@ void CPU::testOpcodes() {
                 emulator->testRam[test["initial"]["ram"][j][0].get<int>()] = test["initial"]["ram"][j][1].get<uint8_t>();
             }
 
-            //run opcode
-            (this->*opcode.AddrMode)();
-            updateAbsolute();
-            (this->*opcode.OpFunction)();
-            accumulatorMode = false;
+            //run opcode, whichever core is selected
+            operand = readOperand(state.program_counter, opcodeTable[t >> 4][t & 0x0F].byteCount);
+            execute(t);
 
             //check if passed test
             if (test["final"]["a"] != state.accumulator) {
@@ -1097,4 +1957,101 @@ void CPU::testOpcodes() {
     printf(GREEN "CPU: Opcode Tests:, %i passes, %i fails\n" RESET, opcodePasses, opcodeFails);
     printf(YELLOW "CPU: Skipped %i opcodes,count as failures\n" RESET, opcodeSkips);
 
-}
\ No newline at end of file
+}
+
+const char *CPU::opcodeMnemonic(uint8_t opcodeByte) {
+    return opcodeTable[opcodeByte >> 4][opcodeByte & 0x0F].mnemonic;
+}
+
+const char *CPU::addressingModeName(uint8_t opcodeByte) {
+    static const struct {
+        void (CPU::*mode)();
+        const char *name;
+    } modes[] = {
+        {&CPU::IMPL, "IMPL"}, {&CPU::ACC, "ACC"}, {&CPU::IMM, "IMM"}, {&CPU::REL, "REL"},
+        {&CPU::ZPG, "ZPG"}, {&CPU::ZPGX, "ZPGX"}, {&CPU::ZPGY, "ZPGY"},
+        {&CPU::ABS, "ABS"}, {&CPU::ABSX, "ABSX"}, {&CPU::ABSY, "ABSY"},
+        {&CPU::IND, "IND"}, {&CPU::XIND, "XIND"}, {&CPU::INDY, "INDY"}
+    };
+    void (CPU::*mode)() = opcodeTable[opcodeByte >> 4][opcodeByte & 0x0F].AddrMode;
+    for (const auto &entry : modes) {
+        if (entry.mode == mode) {
+            return entry.name;
+        }
+    }
+    return "JAM";
+}
+
+bool CPU::opcodeRuns(uint8_t opcodeByte) {
+    return opcodeTable[opcodeByte >> 4][opcodeByte & 0x0F].byteCount != 0;
+}
+
+void CPU::prepareOpcodeBenchmark(uint8_t opcodeByte) {
+    //testing ram layout
+    //$0000-$00FF zeropage, every pointer in it points at $0202
+    //$0100-$01FF stack, pulls return $0404 so RTS and RTI land back in the copies
+    //$0200-$03FF data for the absolute and indirect modes
+    //$0400-$FFEF copies of the instruction, then a JMP back to $0400
+    //$FFFA-$FFFF every vector at $0400 for BRK
+    uint8_t *ram = emulator->testRam;
+    memset(ram, 0x02, 0x100);
+    memset(ram + 0x100, 0x04, 0x100);
+    memset(ram + 0x200, 0x5A, 0x200);
+
+    const OpcodeInfo &opcode = opcodeTable[opcodeByte >> 4][opcodeByte & 0x0F];
+    int byteCount = std::max<int>(opcode.byteCount, 1);
+    int address = 0x0400;
+    for (; address + byteCount + 3 <= 0xFFF0; address += byteCount) {
+        ram[address] = opcodeByte;
+        if (byteCount == 2) {
+            //branches go to the next copy taken or not, everything else works on $10
+            ram[address + 1] = opcode.AddrMode == &CPU::REL ? 0x00 : 0x10;
+        } else if (byteCount == 3) {
+            uint16_t target = 0x0280;
+            if (opcode.AddrMode == &CPU::IND) {
+                //JMP ($0200) to $0400, which is the same JMP again
+                target = 0x0200;
+                ram[0x0200] = 0x00;
+                ram[0x0201] = 0x04;
+            } else if (opcode.OpFunction == &CPU::JMP || opcode.OpFunction == &CPU::JSR) {
+                //jumps to itself
+                target = address;
+            }
+            ram[address + 1] = target & 0xFF;
+            ram[address + 2] = target >> 8;
+        }
+    }
+    ram[address] = 0x4C;
+    ram[address + 1] = 0x00;
+    ram[address + 2] = 0x04;
+    for (int vector = 0xFFFA; vector < 0x10000; vector += 2) {
+        ram[vector] = 0x00;
+        ram[vector + 1] = 0x04;
+    }
+
+    accumulatorMode = false;
+    state.accumulator = 0x40;
+    state.x_register = 0x01;
+    state.y_register = 0x01;
+    state.program_counter = 0x0400;
+    state.stack_pointer = 0xFD;
+    state.status_register = 0x24;
+    state.remaining_cycles = 0;
+    benchmarkStart = state;
+}
+
+void CPU::benchmarkIsolated(uint8_t opcodeByte, int count) {
+    uint8_t byteCount = opcodeTable[opcodeByte >> 4][opcodeByte & 0x0F].byteCount;
+    for (int i = 0; i < count; i++) {
+        state = benchmarkStart;
+        accumulatorMode = false;
+        operand = readOperand(state.program_counter, byteCount);
+        execute(opcodeByte);
+    }
+}
+
+void CPU::benchmarkLoop(int count) {
+    for (int i = 0; i < count; i++) {
+        runInstruction();
+    }
+}
@@ -2,6 +2,9 @@
 #pragma once
 #include <cstdint>
 #include <vector>
+#include <array>
+#include <cstddef>
+#include <utility>
 #include "../Definitions.h"
 
 class Emulator;
@@ -13,20 +16,82 @@ public:
 
     void reset();
     void nmi();
+
+    //level triggered IRQ line, low while any source holds it. it only changes at scheduler events and register
+    //writes, the cpu looks at it between instructions and takes the interrupt while the I flag is clear
+    enum IrqSource : uint8_t {
+        IRQ_MAPPER = 0x01
+    };
+    uint8_t irqLine = 0;
+    inline void setIrq(uint8_t source, bool held) {
+        irqLine = held ? (irqLine | source) : (irqLine & ~source);
+    }
     CpuState *getState();
     int cycleCount = 0;
     void runInstruction();    
     void clock();
 
+    //upcoming clock calls that only count down, the scheduler can run the ppu through these without stopping
+    inline int freeCycles() {
+        if (idleCycles > 0) return idleCycles;
+        //nmi adds 7 to the counter, keep room so it cant wrap in the middle of a batch
+        return state.remaining_cycles <= 248 ? state.remaining_cycles : 0;
+    }
+    //same as calling clock count times when count <= freeCycles()
+    void skipCycles(int count);
+
     void testOpcodes();
 
+    //opcode microbenchmarks, these run on the flat testing ram and benchmarks/cpubench.cpp times them
+    static const char *opcodeMnemonic(uint8_t opcodeByte);
+    static const char *addressingModeName(uint8_t opcodeByte);
+    //false for the JAM opcodes, which lock up the cpu
+    static bool opcodeRuns(uint8_t opcodeByte);
+    //fills testing ram with copies of one instruction, operands are picked so every copy keeps running inside the copies
+    void prepareOpcodeBenchmark(uint8_t opcodeByte);
+    //runs the instruction count times from the same state, without the fetch
+    void benchmarkIsolated(uint8_t opcodeByte, int count);
+    //fetches and runs count instructions out of the prepared ram
+    void benchmarkLoop(int count);
+
+    //run opcodes through the original opcodeTable member pointers instead of the specialized handlers. the
+    //interpreter doesnt check this per instruction, setting it swaps the handler table and drops the decode cache
+    void setReferenceCore(bool enabled);
+    bool getReferenceCore();
+
+    //decode cache upkeep, ram writes only pay for a flag check unless the byte was decoded as code
+    inline void ramWritten(uint16_t ramAddress) {
+        if (ramCodeBytes[ramAddress]) invalidateRamCode(ramAddress);
+    }
+    //drops every cached instruction, for cartridge swaps
+    void invalidateDecodeCache();
+    //drops what was cached for PRG space between start and end (exclusive), for bank switches
+    void invalidatePrgCode(uint16_t start, int end);
+
+    //optional threaded block backend, hot PRG basic blocks run as one unit between PPU sync points. a block is its
+    //decoded instructions called one after the other through their specialized handlers, no native code is generated
+    bool blockBackend = false;
+    //replays every block through the reference interpreter and reports any difference in state
+    bool blockCrossCheck = false;
+    int blocksTranslated = 0;
+    int blockMismatches = 0;
+
+    //fast forward side effect free polling loops up to the PPU's next event
+    bool idleSkip = true;
+    long long idleCyclesSkipped = 0;
+
 private:
     CpuState state;
+    //state prepareOpcodeBenchmark leaves, every isolated run starts from it
+    CpuState benchmarkStart;
 
     Emulator *emulator;
 
-    //used during opcodes
+    //used during opcodes by the reference core. the fused handlers only keep absolute_address up to date, since
+    //implied opcodes read whatever address the instruction before them used
     uint16_t absolute_address;
+    //operand bytes following the opcode, filled in before the addressing mode runs
+    uint16_t operand;
     //storage variable seperate to RAM to handle addressing modes
     uint8_t absolute_data;
 
@@ -40,6 +105,8 @@ private:
     void setFlag(uint8_t flag, bool value);
     void pushStack(uint8_t value);
     uint8_t pullStack();
+    //interrupt sequence for the IRQ line, like nmi through $FFFE
+    void irq();
 
     //addressing modes, in order of their documentation on https://www.masswerk.at/6502/6502_instruction_set.html
     void IMPL(); //Implied
@@ -157,7 +224,7 @@ private:
 
     //indexed [row][column]
     //also [firstNibble][secondNibble] when decoding opcodes
-    const OpcodeInfo opcodeTable[16][16] = {
+    static constexpr OpcodeInfo opcodeTable[16][16] = {
         //0                                    //1                                  //2                                 //3                                  //4                                  //5                                  //6                                  //7                                  //8                                  //9                                  //A                                  //B                                   //C                                  //D                                  //E                                  //F
         {{&CPU::BRK, &CPU::IMPL, "BRK", 1, 7},{&CPU::ORA, &CPU::XIND, "ORA", 2, 6},{&CPU::XXX, &CPU::XXX, "JAM", 0, 0},{&CPU::SLO, &CPU::XIND, "SLO", 2, 8},{&CPU::NOP, &CPU::ZPG, "NOP", 2, 3}, {&CPU::ORA, &CPU::ZPG, "ORA", 2, 3}, {&CPU::ASL, &CPU::ZPG, "ASL", 2, 5}, {&CPU::SLO, &CPU::ZPG, "SLO", 2, 5}, {&CPU::PHP, &CPU::IMPL, "PHP", 1, 3},{&CPU::ORA, &CPU::IMM, "ORA", 2, 2}, {&CPU::ASL, &CPU::ACC, "ASL", 1, 2}, {&CPU::ANC, &CPU::IMM, "ANC", 2, 2},  {&CPU::NOP, &CPU::ABS, "NOP", 3, 4}, {&CPU::ORA, &CPU::ABS, "ORA", 3, 4}, {&CPU::ASL, &CPU::ABS, "ASL", 3, 6}, {&CPU::SLO, &CPU::ABS, "SLO", 3, 6}}, //0
         {{&CPU::BPL, &CPU::REL, "BPL", 2, 2}, {&CPU::ORA, &CPU::INDY, "ORA", 2, 5},{&CPU::XXX, &CPU::XXX, "JAM", 0, 0},{&CPU::SLO, &CPU::INDY, "SLO", 2, 8},{&CPU::NOP, &CPU::ZPGX, "NOP", 2, 4},{&CPU::ORA, &CPU::ZPGX, "ORA", 2, 4},{&CPU::ASL, &CPU::ZPGX, "ASL", 2, 6},{&CPU::SLO, &CPU::ZPGX, "SLO", 2, 6},{&CPU::CLC, &CPU::IMPL, "CLC", 1, 2},{&CPU::ORA, &CPU::ABSY, "ORA", 3, 4},{&CPU::NOP, &CPU::IMPL, "NOP", 1, 2},{&CPU::SLO, &CPU::ABSY, "SLO", 3, 7}, {&CPU::NOPE, &CPU::ABSX, "NOP", 3, 4},{&CPU::ORA, &CPU::ABSX, "ORA", 3, 4},{&CPU::ASL, &CPU::ABSX, "ASL", 3, 7},{&CPU::SLO, &CPU::ABSX, "SLO", 3, 7}}, //1
@@ -176,4 +243,136 @@ private:
         {{&CPU::CPX, &CPU::IMM, "CPX", 2, 2}, {&CPU::SBC, &CPU::XIND, "SEC", 2, 6},{&CPU::NOP, &CPU::IMM, "NOP", 2, 2},{&CPU::ISC, &CPU::XIND, "ISC", 2, 8},{&CPU::CPX, &CPU::ZPG, "CPX", 2, 3}, {&CPU::SBC, &CPU::ZPG, "SBC", 2, 3}, {&CPU::INC, &CPU::ZPG, "INC", 2, 5}, {&CPU::ISC, &CPU::ZPG, "ISC", 2, 5}, {&CPU::INX, &CPU::IMPL, "INX", 1, 2},{&CPU::SBC, &CPU::IMM, "SBC", 2, 2}, {&CPU::NOP, &CPU::IMPL, "NOP", 1, 2},{&CPU::USBC,&CPU::IMM, "USBC", 2, 2}, {&CPU::CPX, &CPU::ABS, "CPX", 3, 4}, {&CPU::SBC, &CPU::ABS, "SBC", 3, 4}, {&CPU::INC, &CPU::ABS, "INC", 3, 6}, {&CPU::ISC, &CPU::ABS, "ISC", 3, 6}}, //E
         {{&CPU::BEQ, &CPU::REL, "BEQ", 2, 2}, {&CPU::SBC, &CPU::INDY, "SEC", 2, 5},{&CPU::XXX, &CPU::XXX, "JAM", 0, 0},{&CPU::ISC, &CPU::INDY, "ISC", 2, 8},{&CPU::NOP, &CPU::ZPGX, "NOP", 2, 4},{&CPU::SBC, &CPU::ZPGX, "SBC", 2, 4},{&CPU::INC, &CPU::ZPGX, "INC", 2, 6},{&CPU::ISC, &CPU::ZPGX, "ISC", 2, 6},{&CPU::SED, &CPU::IMPL, "SED", 1, 2},{&CPU::SBC, &CPU::ABSY, "SBC", 3, 4},{&CPU::NOP, &CPU::IMPL, "NOP", 1, 2},{&CPU::ISC, &CPU::ABSY, "LSC", 3, 7}, {&CPU::NOPE, &CPU::ABSX, "NOP", 3, 4},{&CPU::SBC, &CPU::ABSX, "SBC", 3, 4},{&CPU::INC, &CPU::ABSX, "INC", 3, 7},{&CPU::ISC,&CPU::ABSX, "ISC", 3, 7}} //F
     };
+
+    //one specialized handler per opcode, the addressing mode and operation are picked out of opcodeTable at compile
+    //time and forced inline into it. the mode returns the effective address and the operation gets it and the byte
+    //there as arguments instead of going through members. bus accesses stay calls into Emulator wherever g++ doesnt
+    //inline cpuBusRead and cpuBusWrite itself
+    typedef void (*OpcodeHandler)(CPU *cpu, uint16_t operand);
+
+    template <uint8_t opcodeByte>
+    static void executeOpcode(CPU *cpu, uint16_t operand);
+
+    template <void (CPU::*mode)(), bool pageCycle>
+    uint16_t effectiveAddress(uint16_t operand);
+    template <void (CPU::*mode)(), void (CPU::*operation)()>
+    void operate(uint16_t address, uint8_t value);
+
+    //operation bodies the fused handlers share
+    void setZeroNegative(uint8_t value);
+    void addWithCarry(uint8_t value);
+    void compare(uint8_t reg, uint8_t value);
+    void branch(bool taken, uint16_t target);
+    uint8_t writeBack(uint16_t address, uint8_t result);
+
+    //same signature around executeReference, so switching cores is only a different table
+    template <uint8_t opcodeByte>
+    static void referenceOpcode(CPU *cpu, uint16_t operand);
+
+    template <bool reference, std::size_t... opcodeBytes>
+    static constexpr std::array<OpcodeHandler, 256> buildDispatchTable(std::index_sequence<opcodeBytes...>);
+
+    static const std::array<OpcodeHandler, 256> dispatchTable;
+    static const std::array<OpcodeHandler, 256> referenceTable;
+
+    //the table runInstruction and the decode cache take handlers from
+    bool referenceCore = false;
+    const OpcodeHandler *handlers = dispatchTable.data();
+
+    //decodes through opcodeTable at runtime, the reference the specialized handlers are validated against
+    void executeReference(uint8_t opcodeByte);
+
+    void execute(uint8_t opcodeByte);
+    uint16_t readOperand(uint16_t address, uint8_t byteCount);
+
+    //pre-decoded instructions keyed by program counter, so the hot loop skips the bus walk for the opcode and operand
+    struct DecodedInstruction {
+        OpcodeHandler handler;
+        uint16_t operand;
+        uint8_t opcodeByte;
+        uint8_t byteCount;
+        uint8_t cycleCount;
+        bool valid;
+    };
+
+    //internal ram ($0000-$07FF, mirrors share entries) first, then PRG space ($8000-$FFFF)
+    static constexpr int DECODE_RAM_ENTRIES = 0x0800;
+    std::vector<DecodedInstruction> decodeCache;
+
+    //set for every ram byte that is part of a cached instruction
+    uint8_t ramCodeBytes[0x0800];
+
+    DecodedInstruction *lookupDecoded(uint16_t address);
+    DecodedInstruction *decode(uint16_t address);
+    void invalidateRamCode(uint16_t ramAddress);
+
+    //threaded blocks
+    enum BlockAccess : uint8_t {
+        BLOCK_ACCESS_NONE,
+        BLOCK_ACCESS_INDEXED_X,
+        BLOCK_ACCESS_INDEXED_Y,
+        BLOCK_ACCESS_INDIRECT_X,
+        BLOCK_ACCESS_INDIRECT_Y,
+        BLOCK_ACCESS_INDIRECT
+    };
+
+    struct BlockInstruction {
+        DecodedInstruction decoded;
+        //how the effective address has to be checked before running
+        BlockAccess access;
+        bool writes;
+    };
+
+    struct TranslatedBlock {
+        std::vector<BlockInstruction> instructions;
+    };
+
+    struct BlockSnapshot {
+        CpuState state;
+        uint16_t absolute_address;
+        uint8_t absolute_data;
+        uint8_t ram[0x0800];
+    };
+
+    static constexpr int BLOCK_NOT_TRANSLATED = -1;
+    static constexpr int BLOCK_UNTRANSLATABLE = -2;
+    static constexpr int BLOCK_HOT_THRESHOLD = 8;
+    static constexpr size_t MAX_BLOCK_INSTRUCTIONS = 24;
+    //blocks dropped by bank switches stay in the list until it grows past this
+    static constexpr size_t MAX_BLOCKS = 0x4000;
+
+    std::vector<TranslatedBlock> blocks;
+    //PRG space address -> index into blocks
+    std::vector<int32_t> blockLookup;
+    //times a block start was reached before being translated
+    std::vector<uint8_t> blockHeat;
+
+    bool runBlock();
+    void translateBlock(uint16_t address);
+    bool blockAccessSafe(const BlockInstruction &instruction);
+    static bool safeBlockAddress(uint16_t address, bool writes);
+    static bool endsBlock(const OpcodeInfo &opcode);
+    static bool writesMemory(const OpcodeInfo &opcode);
+    void takeBlockSnapshot(BlockSnapshot &snapshot);
+    void crossCheckBlock(const BlockSnapshot &before, int executed);
+
+    //idle loop detection
+    static constexpr uint8_t IDLE_LOOP_UNKNOWN = 0;
+    static constexpr uint8_t IDLE_LOOP_NONE = 0xFF;
+    static constexpr uint8_t MAX_IDLE_LOOP_INSTRUCTIONS = 8;
+
+    //PRG space address -> instructions in the idle loop starting there
+    std::vector<uint8_t> idleLoopInfo;
+
+    uint16_t idleHead = 0;
+    int idleVisits = 0;
+    CpuState idleState;
+    int idleVisitCycle = 0;
+    int idlePeriod = 0;
+    //cpu cycles still to be spent in skipped passes
+    int idleCycles = 0;
+
+    uint8_t idleLoopLength(uint16_t head);
+    void trackIdleLoop(uint16_t previousPC);
+    bool skipIdleLoop();
 };
\ No newline at end of file
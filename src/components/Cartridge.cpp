@@ -1,4 +1,7 @@
 #include "Cartridge.h"
+#include "Mapper.h"
+#include "BatterySave.h"
+#include "../Log.h"
 #include <cstdio>
 #include <cstdlib>
 #include <string.h>
@@ -6,81 +9,210 @@
 Cartridge::Cartridge() {
     this->PRG_ROM = nullptr;
     this->CHR_ROM = nullptr;
+    this->chrRamData = nullptr;
+    this->tiles = &ramTiles;
+    this->PRG_RAM = nullptr;
+    this->battery = nullptr;
     this->mapper = 0;
     this->PRGsize = 0;
     this->CHRsize = 0;
+    this->board = nullptr;
+    memset(prgBanks, 0, sizeof(prgBanks));
+    memset(chrBanks, 0, sizeof(chrBanks));
+    memset(fourScreenRam, 0, sizeof(fourScreenRam));
 }
 
 Cartridge::~Cartridge() {
-    delete[] PRG_ROM;
-    delete[] CHR_ROM;
+    delete board;
+    //PRG and CHR-ROM belong to the image, which is unmapped when its last cartridge goes
+    delete[] chrRamData;
+    //battery RAM lives in the save file mapping, deleting the save flushes it
+    if (battery != nullptr) {
+        delete battery;
+    } else {
+        delete[] PRG_RAM;
+    }
+}
+
+std::string Cartridge::romPath(const char* cartName) {
+    std::string gamePath = cartName;
+    bool isPath = gamePath.find('/') != std::string::npos ||
+        (gamePath.size() > 4 && gamePath.compare(gamePath.size() - 4, 4, ".nes") == 0);
+    if (!isPath) {
+        gamePath = ROM_DIRECTORY "/" + gamePath + ".nes";
+    }
+    return gamePath;
 }
 
-int Cartridge::loadRom(char* cartName) {
+Cartridge::LoadResult Cartridge::loadRom(const char* cartName, const RomHeader *indexed) {
     //load cartridge, using iNES spec to support most NES roms
 
-    printf(YELLOW "Cartridge: Loading ROM\n" RESET);
+    logPrintf(YELLOW "Cartridge: Loading ROM\n" RESET);
 
     //file location from name
-    char gamePath[41] = "../testRoms/";
-    strcat(gamePath, cartName);
-    strcat(gamePath, ".nes");
-
-    //open rom file
-    FILE* fp = fopen(gamePath, "rb");
+    std::string gamePath = romPath(cartName);
 
-    if (fp == NULL)
+    //map the rom file, shared with any other cartridge that has it open
+    image = RomImage::open(gamePath.c_str());
+    if (image == nullptr)
     {
-        printf(RED "Cartridge: Could not open file %s\n" RESET, gamePath);
-        return 1;
+        logPrintf(RED "Cartridge: Could not open file %s\n" RESET, gamePath.c_str());
+        return LOAD_NOT_FOUND;
     }
+    const uint8_t *file = image->data();
 
-    //iNES header is 16 bytes
-    uint8_t header[16];
-    fread(&header, sizeof(uint8_t), 16, fp);
+    //the library already has the (corrected) header of indexed roms
+    RomHeader header;
+    if (indexed != nullptr) {
+        header = *indexed;
+    } else if (parseRomHeader(file, image->size(), header) != 0) {
+        logPrintf(RED "Cartridge: Invalid iNES header\n" RESET);
+        return LOAD_BAD_HEADER;
+    }
 
-    //check if header is valid
-    if (header[0] != 'N' || header[1] != 'E' || header[2] != 'S' || header[3] != 0x1A)
-    {
-        printf(RED "Cartridge: Invalid iNES header\n" RESET);
-        return 1;
+    mapper = header.mapper;
+    board = Mapper::create(mapper, this);
+    if (board == nullptr) {
+        logPrintf(RED "Cartridge: Mapper %d not supported\n" RESET, mapper);
+        return LOAD_UNSUPPORTED_MAPPER;
+    }
+
+    mirroring = (Mirroring)header.mirroring;
+
+    //banks are switched in 8kb steps for PRG and 1kb steps for CHR, NES 2.0 sizes can be any multiple of 1, 3, 5 or 7
+    if (header.prgSize < 0x2000 || header.prgSize % 0x2000 != 0) {
+        logPrintf(RED "Cartridge: PRG-ROM is not a multiple of 8kb\n" RESET);
+        return LOAD_BAD_SIZE;
+    }
+    if (header.chrSize % 0x400 != 0) {
+        logPrintf(RED "Cartridge: CHR-ROM is not a multiple of 1kb\n" RESET);
+        return LOAD_BAD_SIZE;
     }
+    //the banks are read straight out of the mapping, so a truncated file cant be padded out
+    if (image->size() < header.fileSize()) {
+        logPrintf(RED "Cartridge: File is shorter than its header says\n" RESET);
+        return LOAD_BAD_SIZE;
+    }
+    PRGsize = header.prgSize;
+    CHRsize = header.chrSize;
+    //512 byte trainer before PRG-ROM, not used by anything we run
+    PRG_ROM = file + header.prgOffset();
+    CHR_ROM = PRG_ROM + PRGsize;
 
-    //header structure:
-    // 4-> PRGROM size in 16kb chunks
-    // 5-> CHRROM size in 8kb chunks
-    //6-15-> other flags and padding
+    //a CHR bank count of 0 means the board has CHR-RAM instead
+    chrRam = CHRsize == 0;
+    if (chrRam) {
+        CHRsize = header.chrRamSize > CHR_ROM_BANKSIZE ? header.chrRamSize : CHR_ROM_BANKSIZE;
+        chrRamData = new uint8_t[CHRsize]();
+        CHR_ROM = chrRamData;
+        ramTiles.build(CHR_ROM, CHRsize);
+        tiles = &ramTiles;
+    } else {
+        tiles = image->chrTiles(CHR_ROM, CHRsize);
+    }
 
-    PRGsize = header[4] * PRG_ROM_BANKSIZE;
-    CHRsize = header[5] * CHR_ROM_BANKSIZE;
+    //$6000-$7FFF work ram, every board gets it since nothing in iNES 1 headers says which have it
+    //battery backed boards keep it in a save file next to the rom
+    if (header.battery) {
+        //same name with the extension swapped
+        size_t extension = gamePath.find_last_of('.');
+        if (extension == std::string::npos || extension < gamePath.find_last_of('/') + 1) {
+            extension = gamePath.size();
+        }
+        std::string savePath = gamePath.substr(0, extension) + ".sav";
 
-    //mapper 0
-    PRG_ROM = new uint8_t[PRGsize];
-    CHR_ROM = new uint8_t[CHRsize];
+        battery = new BatterySave();
+        if (battery->open(savePath.c_str(), PRG_RAM_SIZE) == 0) {
+            PRG_RAM = battery->data();
+        } else {
+            logPrintf(YELLOW "Cartridge: Battery RAM will not be saved\n" RESET);
+            delete battery;
+            battery = nullptr;
+        }
+    }
+    if (PRG_RAM == nullptr) {
+        PRG_RAM = new uint8_t[PRG_RAM_SIZE]();
+    }
 
-    //read data into object
-    fread(PRG_ROM, sizeof(uint8_t), PRGsize, fp);
-    fread(CHR_ROM, sizeof(uint8_t), CHRsize, fp);
+    board->reset();
 
-    // close the file
-    fclose(fp);
-    printf(GREEN "Cartridge: ROM loaded%s\n" RESET, gamePath);
-    printf(GREEN "Cartridge: ROM info: PRG banks: %d, CHR banks: %d\n" RESET, header[4], header[5]);
-    return 0;
+    logPrintf(GREEN "Cartridge: ROM loaded%s\n" RESET, gamePath.c_str());
+    logPrintf(GREEN "Cartridge: ROM info: mapper: %d, PRG banks: %d, CHR banks: %d%s, mirroring: %d\n" RESET, mapper, PRGsize / PRG_ROM_BANKSIZE, header.chrSize / CHR_ROM_BANKSIZE, chrRam ? " (CHR-RAM)" : "", mirroring);
+    return LOAD_OK;
+}
+
+Cartridge::LoadResult Cartridge::loadChr(const uint8_t *chr, Mirroring mirroring, bool writable) {
+    mapper = 0;
+    board = Mapper::create(mapper, this);
+    this->mirroring = mirroring;
+
+    //PRG-ROM points at the work ram, so every bank the cpu map asks for is something
+    PRG_RAM = new uint8_t[PRG_RAM_SIZE]();
+    PRG_ROM = PRG_RAM;
+    PRGsize = PRG_RAM_SIZE;
+
+    CHRsize = CHR_ROM_BANKSIZE;
+    chrRamData = new uint8_t[CHRsize];
+    memcpy(chrRamData, chr, CHRsize);
+    CHR_ROM = chrRamData;
+    //copies of CHR-ROM stay read only to the ppu
+    chrRam = writable;
+    ramTiles.build(CHR_ROM, CHRsize);
+    tiles = &ramTiles;
+
+    board->reset();
+    return LOAD_OK;
+}
+
+void Cartridge::writeChr(uint16_t address, uint8_t data) {
+    chrRamData[chrAddress(address)] = data;
+    tiles->invalidate(chrAddress(address));
+}
+
+const uint8_t *Cartridge::prgPointer(uint16_t address)
+{
+    return PRG_ROM + prgBanks[(address >> 13) & 0x03] + (address & 0x1FFF);
+}
+
+const uint8_t *Cartridge::chrPointer(uint16_t address)
+{
+    return CHR_ROM + chrAddress(address);
+}
+
+uint8_t *Cartridge::chrWritePointer(uint16_t address)
+{
+    return chrRam ? chrRamData + chrAddress(address) : nullptr;
+}
+
+uint8_t *Cartridge::prgRamPointer(uint16_t address)
+{
+    return PRG_RAM + (address & (PRG_RAM_SIZE - 1));
 }
 
 uint8_t Cartridge::read(uint16_t address)
 {
-     //mapper 0 mirroring
     if (address >= 0x8000 && address <= 0xFFFF)
     {
-        return PRG_ROM[address & (PRGsize - 1)];
+        return *prgPointer(address);
     }
     if (address >= 0x0000 && address <= 0x1FFF)
     {
-        return CHR_ROM[address];
+        return *chrPointer(address);
     }
     
-    printf(RED "invalid cartridge read 0x%04X\n" RESET, address);
+    logPrintf(RED "invalid cartridge read 0x%04X\n" RESET, address);
     return 0;
+}
+
+void Cartridge::write(uint16_t address, uint8_t data)
+{
+    if (address >= 0x8000)
+    {
+        board->write(address, data);
+    }
+}
+
+void Cartridge::reset()
+{
+    board->reset();
 }
\ No newline at end of file
@@ -2,8 +2,16 @@
 #pragma once
 #include <cstdint>
 #include <vector>
+#include <memory>
+#include <string>
 #include "../Definitions.h"
 #include "CPU.h"
+#include "TileCache.h"
+#include "RomImage.h"
+#include "RomHeader.h"
+
+class Mapper;
+class BatterySave;
 
 class Cartridge {
 public:
@@ -11,15 +19,93 @@ public:
     ~Cartridge();
 
     uint8_t read(uint16_t address);
-    void write(uint16_t address);
-    int loadRom(char* cartName);
+    //direct pointer into the PRG-ROM bank mapped at a cpu address, read only since it points into the rom file
+    const uint8_t *prgPointer(uint16_t address);
+    //direct pointer into the CHR bank mapped at a ppu address
+    const uint8_t *chrPointer(uint16_t address);
+    //same for writes, nullptr unless the board has CHR-RAM
+    uint8_t *chrWritePointer(uint16_t address);
+    //direct pointer into PRG-RAM at $6000-$7FFF
+    uint8_t *prgRamPointer(uint16_t address);
+    //mapper registers, may change banks
+    void write(uint16_t address, uint8_t data);
+    void reset();
+    //a bare name is looked up as ROM_DIRECTORY/<name>.nes, anything with a / or ending in .nes is a path
+    static std::string romPath(const char* cartName);
+    //why loadRom failed, if it did
+    enum LoadResult {
+        LOAD_OK,
+        LOAD_NOT_FOUND,
+        LOAD_BAD_HEADER,
+        LOAD_UNSUPPORTED_MAPPER,
+        LOAD_BAD_SIZE
+    };
+    //header is the rom library's entry for the file, nullptr to parse the file's own header
+    LoadResult loadRom(const char* cartName, const RomHeader *header = nullptr);
 
     int PRGsize;
     int CHRsize;
     int mapper;
-    const char* mirroring = "horizontal";
+    //boards without CHR-ROM have 8kb of CHR-RAM the ppu can write
+    bool chrRam = false;
+    //bank switching and IRQ hardware on the board
+    Mapper *board;
+
+    //offset into PRG-ROM of the 8kb bank at $8000, $A000, $C000 and $E000
+    int prgBanks[4];
+    //offset into CHR of the 1kb bank at each of $0000-$1FFF
+    int chrBanks[8];
+
+    //CHR offset of a pattern address, for lookups into the tile cache
+    inline int chrAddress(uint16_t address) {
+        return chrBanks[(address >> 10) & 0x07] | (address & 0x03FF);
+    }
+    //CHR-RAM write through the ppu page table, the decoded tile is stale now
+    inline void chrWritten(uint16_t address) {
+        tiles->invalidate(chrAddress(address));
+    }
+    //pattern byte of a loadChr board, written even when the ppu cant, for the CHR bank switches in a ppu trace
+    void writeChr(uint16_t address, uint8_t data);
+
+    //set by the mapper when a write moved a bank, the emulator remaps what changed and clears them
+    enum BankChange : uint8_t {
+        //shifted left by the PRG slot
+        CHANGED_PRG_SLOT = 0x01,
+        CHANGED_CHR = 0x10,
+        CHANGED_MIRRORING = 0x20
+    };
+    uint8_t bankChanges = 0;
+
+    //which nametable each of the 4 ppu nametable slots shows, from header byte 6 or set by a mapper
+    enum Mirroring {
+        MIRROR_HORIZONTAL,
+        MIRROR_VERTICAL,
+        MIRROR_SINGLE_LOW,
+        MIRROR_SINGLE_HIGH,
+        MIRROR_FOUR_SCREEN
+    };
+    Mirroring mirroring = MIRROR_HORIZONTAL;
+
+    //a mapper 0 board with nothing but a copy of 8kb of chr, for replaying a ppu trace without the rom
+    //there is no PRG, the cpu would see the zeroed work ram in every bank
+    LoadResult loadChr(const uint8_t *chr, Mirroring mirroring, bool writable);
+
+    //extra 2kb of vram four screen carts bring for nametables 2 and 3
+    uint8_t fourScreenRam[0x800];
+
+    //CHR decoded once at load, for both renderers and the pattern table viewer
+    //CHR-ROM tiles are shared with every cartridge running the same rom, CHR-RAM gets its own
+    TileCache *tiles;
 
 private:
-    uint8_t* PRG_ROM;
-    uint8_t* CHR_ROM;
+    //the mapped rom file, PRG_ROM and CHR_ROM point into it
+    std::shared_ptr<RomImage> image;
+    const uint8_t* PRG_ROM;
+    //CHR-ROM, or chrRamData on boards without it
+    const uint8_t* CHR_ROM;
+    uint8_t* chrRamData;
+    TileCache ramTiles;
+    uint8_t* PRG_RAM;
+    //save file backing PRG_RAM on battery boards, nullptr otherwise
+    BatterySave *battery;
 };
\ No newline at end of file
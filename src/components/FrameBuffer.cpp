@@ -0,0 +1,130 @@
+#include "FrameBuffer.h"
+#include <string.h>
+
+//ssse3 byte shuffles do the lookups, picked at runtime since the build only assumes sse2
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define FRAMEBUFFER_SSSE3
+#include <tmmintrin.h>
+#endif
+
+FrameBuffer::FrameBuffer() {
+    //black, a couple of pixels never get drawn
+    memset(pixels, 0x0F, sizeof(pixels));
+    memset(emphasis, 0, sizeof(emphasis));
+    memset(colors, 0, sizeof(colors));
+    memset(planes, 0, sizeof(planes));
+}
+
+void FrameBuffer::setPalette(const uint32_t *palette) {
+    for (int e = 0; e < 8; e++) {
+        for (int i = 0; i < 64; i++) {
+            int r = (palette[i] >> 24) & 0xFF;
+            int g = (palette[i] >> 16) & 0xFF;
+            int b = (palette[i] >> 8) & 0xFF;
+
+            //emphasis bits are red, green, blue, each one darkens the other two channels to about 82%
+            if (e & 0b110) r = (r * 209) >> 8;
+            if (e & 0b101) g = (g * 209) >> 8;
+            if (e & 0b011) b = (b * 209) >> 8;
+
+            colors[FORMAT_RGBA8888][e][i] = (r << 24) | (g << 16) | (b << 8) | 0xFF;
+            colors[FORMAT_BGRA8888][e][i] = (b << 24) | (g << 16) | (r << 8) | 0xFF;
+            colors[FORMAT_RGB565][e][i] = ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3);
+
+            for (int format = 0; format < FORMAT_COUNT; format++) {
+                for (int n = 0; n < 4; n++) {
+                    planes[format][e][n][i] = colors[format][e][i] >> (n * 8);
+                }
+            }
+        }
+    }
+}
+
+#ifdef FRAMEBUFFER_SSSE3
+__attribute__((target("ssse3")))
+static void expandLineSSSE3(const uint8_t *pixels, uint8_t *output, const uint8_t planes[4][64], int bytesPerPixel) {
+    //each plane is 4 tables of 16 bytes, the low nibble of a color shuffles within a table and the high nibble picks one
+    __m128i tables[4][4];
+    for (int n = 0; n < bytesPerPixel; n++) {
+        for (int t = 0; t < 4; t++) {
+            tables[n][t] = _mm_loadu_si128((const __m128i *)(planes[n] + t * 16));
+        }
+    }
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+
+    for (int x = 0; x < DEFAULT_WIDTH; x += 16) {
+        __m128i color = _mm_loadu_si128((const __m128i *)(pixels + x));
+        __m128i low = _mm_and_si128(color, nibble);
+        __m128i high = _mm_and_si128(_mm_srli_epi16(color, 4), nibble);
+        __m128i select[4];
+        for (int t = 0; t < 4; t++) {
+            select[t] = _mm_cmpeq_epi8(high, _mm_set1_epi8(t));
+        }
+
+        __m128i bytes[4];
+        for (int n = 0; n < bytesPerPixel; n++) {
+            bytes[n] = _mm_setzero_si128();
+            for (int t = 0; t < 4; t++) {
+                bytes[n] = _mm_or_si128(bytes[n], _mm_and_si128(_mm_shuffle_epi8(tables[n][t], low), select[t]));
+            }
+        }
+
+        //interleave the planes back into pixels
+        __m128i *out = (__m128i *)(output + x * bytesPerPixel);
+        if (bytesPerPixel == 4) {
+            __m128i low01 = _mm_unpacklo_epi8(bytes[0], bytes[1]);
+            __m128i high01 = _mm_unpackhi_epi8(bytes[0], bytes[1]);
+            __m128i low23 = _mm_unpacklo_epi8(bytes[2], bytes[3]);
+            __m128i high23 = _mm_unpackhi_epi8(bytes[2], bytes[3]);
+            _mm_storeu_si128(out, _mm_unpacklo_epi16(low01, low23));
+            _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(low01, low23));
+            _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(high01, high23));
+            _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(high01, high23));
+        } else {
+            _mm_storeu_si128(out, _mm_unpacklo_epi8(bytes[0], bytes[1]));
+            _mm_storeu_si128(out + 1, _mm_unpackhi_epi8(bytes[0], bytes[1]));
+        }
+    }
+}
+#endif
+
+void FrameBuffer::expand(void *output, int pitch, PixelFormat format) const {
+    int bytesPerPixel = format == FORMAT_RGB565 ? 2 : 4;
+
+#ifdef FRAMEBUFFER_SSSE3
+    static const bool ssse3 = __builtin_cpu_supports("ssse3");
+    if (ssse3) {
+        for (int y = 0; y < DEFAULT_HEIGHT; y++) {
+            expandLineSSSE3(pixels + y * DEFAULT_WIDTH, (uint8_t *)output + y * pitch, planes[format][emphasis[y] & 0x07], bytesPerPixel);
+        }
+        return;
+    }
+#endif
+
+    for (int y = 0; y < DEFAULT_HEIGHT; y++) {
+        const uint8_t *line = pixels + y * DEFAULT_WIDTH;
+        const uint32_t *lineColors = colors[format][emphasis[y] & 0x07];
+        if (bytesPerPixel == 4) {
+            uint32_t *out = (uint32_t *)((uint8_t *)output + y * pitch);
+            for (int x = 0; x < DEFAULT_WIDTH; x++) {
+                out[x] = lineColors[line[x] & 0x3F];
+            }
+        } else {
+            uint16_t *out = (uint16_t *)((uint8_t *)output + y * pitch);
+            for (int x = 0; x < DEFAULT_WIDTH; x++) {
+                out[x] = lineColors[line[x] & 0x3F];
+            }
+        }
+    }
+}
+
+uint64_t FrameBuffer::hash() const {
+    uint64_t hash = 1469598103934665603ULL;
+    for (int i = 0; i < DEFAULT_WIDTH * DEFAULT_HEIGHT; i++) {
+        hash = (hash ^ pixels[i]) * 1099511628211ULL;
+    }
+    for (int i = 0; i < DEFAULT_HEIGHT; i++) {
+        hash = (hash ^ emphasis[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
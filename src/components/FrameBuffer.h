@@ -0,0 +1,37 @@
+// indexed frame the ppu draws into
+#pragma once
+#include <cstdint>
+#include "../Definitions.h"
+
+class FrameBuffer {
+public:
+    FrameBuffer();
+
+    //layouts expand can write, named like the sdl formats (RGBA8888 is 0xRRGGBBAA in a uint32_t)
+    enum PixelFormat {
+        FORMAT_RGBA8888,
+        FORMAT_BGRA8888,
+        FORMAT_RGB565,
+        FORMAT_COUNT
+    };
+
+    //nes color (0-63) of every pixel, a quarter of the size of an rgba frame
+    uint8_t pixels[DEFAULT_WIDTH * DEFAULT_HEIGHT];
+    //PPUMASK emphasis bits (0-7) of every line
+    uint8_t emphasis[DEFAULT_HEIGHT];
+
+    //works out every color in every format from a 64 entry 0xRRGGBBAA palette, expand only does lookups
+    void setPalette(const uint32_t *palette);
+
+    //converts the frame to format, pitch is the length of an output row in bytes
+    void expand(void *output, int pitch, PixelFormat format) const;
+
+    //fnv-1a over the nes colors and the emphasis of every line, the one hash every tool compares frames with
+    uint64_t hash() const;
+
+private:
+    //[format][emphasis][nes color]
+    uint32_t colors[FORMAT_COUNT][8][64];
+    //byte n of every color, for the simd lookups
+    uint8_t planes[FORMAT_COUNT][8][4][64];
+};
@@ -0,0 +1,284 @@
+#include "Mapper.h"
+
+Mapper::Mapper(Cartridge *cartridge) {
+    this->cartridge = cartridge;
+}
+
+Mapper *Mapper::create(int number, Cartridge *cartridge) {
+    switch (number) {
+        case 0:
+            return new Mapper(cartridge);
+        case 1:
+            return new MMC1(cartridge);
+        case 2:
+            return new UxROM(cartridge);
+        case 3:
+            return new CNROM(cartridge);
+        case 4:
+            return new MMC3(cartridge);
+        default:
+            return nullptr;
+    }
+}
+
+void Mapper::reset() {
+    //mapper 0, all of PRG and CHR mapped straight through, 16kb PRG shows up twice
+    mapPrg32k(0);
+    mapChr8k(0);
+}
+
+static int wrapBank(int bank, int count) {
+    //negative banks count back from the end of the rom
+    return ((bank % count) + count) % count;
+}
+
+void Mapper::mapPrg8k(int slot, int bank) {
+    int offset = wrapBank(bank, cartridge->PRGsize / 0x2000) * 0x2000;
+    if (cartridge->prgBanks[slot] != offset) {
+        cartridge->prgBanks[slot] = offset;
+        cartridge->bankChanges |= Cartridge::CHANGED_PRG_SLOT << slot;
+    }
+}
+
+void Mapper::mapPrg16k(int slot, int bank) {
+    mapPrg8k(slot * 2, bank * 2);
+    mapPrg8k(slot * 2 + 1, bank * 2 + 1);
+}
+
+void Mapper::mapPrg32k(int bank) {
+    for (int i = 0; i < 4; i++) {
+        mapPrg8k(i, bank * 4 + i);
+    }
+}
+
+void Mapper::mapChr1k(int slot, int bank) {
+    int count = cartridge->CHRsize / 0x400;
+    if (count == 0) {
+        return;
+    }
+    int offset = wrapBank(bank, count) * 0x400;
+    if (cartridge->chrBanks[slot] != offset) {
+        cartridge->chrBanks[slot] = offset;
+        cartridge->bankChanges |= Cartridge::CHANGED_CHR;
+    }
+}
+
+void Mapper::mapChr2k(int slot, int bank) {
+    mapChr1k(slot * 2, bank * 2);
+    mapChr1k(slot * 2 + 1, bank * 2 + 1);
+}
+
+void Mapper::mapChr4k(int slot, int bank) {
+    for (int i = 0; i < 4; i++) {
+        mapChr1k(slot * 4 + i, bank * 4 + i);
+    }
+}
+
+void Mapper::mapChr8k(int bank) {
+    for (int i = 0; i < 8; i++) {
+        mapChr1k(i, bank * 8 + i);
+    }
+}
+
+void Mapper::setMirroring(Cartridge::Mirroring mirroring) {
+    if (cartridge->mirroring != mirroring) {
+        cartridge->mirroring = mirroring;
+        cartridge->bankChanges |= Cartridge::CHANGED_MIRRORING;
+    }
+}
+
+//MMC1
+
+void MMC1::reset() {
+    shift = 0;
+    shiftCount = 0;
+    control = 0x0C;
+    chrBank0 = 0;
+    chrBank1 = 0;
+    prgBank = 0;
+    updateBanks();
+}
+
+void MMC1::write(uint16_t address, uint8_t data) {
+    //bit 7 clears the shift register and goes back to the fixed last bank
+    if (data & 0x80) {
+        shift = 0;
+        shiftCount = 0;
+        control |= 0x0C;
+        updateBanks();
+        return;
+    }
+
+    shift |= (data & 0x01) << shiftCount;
+    if (++shiftCount < 5) {
+        return;
+    }
+
+    //address bits 13 and 14 pick the register
+    switch ((address >> 13) & 0x03) {
+        case 0:
+            control = shift;
+            break;
+        case 1:
+            chrBank0 = shift;
+            break;
+        case 2:
+            chrBank1 = shift;
+            break;
+        case 3:
+            prgBank = shift;
+            break;
+    }
+    shift = 0;
+    shiftCount = 0;
+    updateBanks();
+}
+
+void MMC1::updateBanks() {
+    static const Cartridge::Mirroring mirrorModes[4] = {
+        Cartridge::MIRROR_SINGLE_LOW, Cartridge::MIRROR_SINGLE_HIGH, Cartridge::MIRROR_VERTICAL, Cartridge::MIRROR_HORIZONTAL
+    };
+    setMirroring(mirrorModes[control & 0x03]);
+
+    //512kb SUROM boards use bit 4 of the CHR register to pick which 256kb the PRG banks come from
+    int outer = cartridge->PRGsize > 0x40000 ? (chrBank0 & 0x10) : 0;
+    switch ((control >> 2) & 0x03) {
+        case 0:
+        case 1:
+            mapPrg32k((outer | (prgBank & 0x0F)) >> 1);
+            break;
+        case 2:
+            //first bank fixed at $8000
+            mapPrg16k(0, outer);
+            mapPrg16k(1, outer | (prgBank & 0x0F));
+            break;
+        case 3:
+            //last bank fixed at $C000
+            mapPrg16k(0, outer | (prgBank & 0x0F));
+            mapPrg16k(1, outer | 0x0F);
+            break;
+    }
+
+    if (control & 0x10) {
+        mapChr4k(0, chrBank0);
+        mapChr4k(1, chrBank1);
+    } else {
+        mapChr8k(chrBank0 >> 1);
+    }
+}
+
+//UxROM
+
+void UxROM::reset() {
+    mapPrg16k(0, 0);
+    mapPrg16k(1, -1);
+    mapChr8k(0);
+}
+
+void UxROM::write(uint16_t address, uint8_t data) {
+    mapPrg16k(0, data);
+}
+
+//CNROM
+
+void CNROM::write(uint16_t address, uint8_t data) {
+    mapChr8k(data);
+}
+
+//MMC3
+
+void MMC3::reset() {
+    bankSelect = 0;
+    static const uint8_t powerOnBanks[8] = {0, 2, 4, 5, 6, 7, 0, 1};
+    for (int i = 0; i < 8; i++) {
+        bankRegisters[i] = powerOnBanks[i];
+    }
+    irqLatch = 0;
+    irqCounter = 0;
+    irqReload = false;
+    irqEnabled = false;
+    irq = false;
+    updateBanks();
+}
+
+void MMC3::write(uint16_t address, uint8_t data) {
+    //register pairs at $8000, $A000, $C000 and $E000, picked by even and odd addresses
+    switch (address & 0xE001) {
+        case 0x8000:
+            bankSelect = data;
+            updateBanks();
+            break;
+        case 0x8001:
+            bankRegisters[bankSelect & 0x07] = data;
+            updateBanks();
+            break;
+        case 0xA000:
+            if (cartridge->mirroring != Cartridge::MIRROR_FOUR_SCREEN) {
+                setMirroring((data & 0x01) ? Cartridge::MIRROR_HORIZONTAL : Cartridge::MIRROR_VERTICAL);
+            }
+            break;
+        case 0xA001:
+            //PRG-RAM protect, ignored since MMC6 boards share the mapper number and use these bits differently
+            break;
+        case 0xC000:
+            irqLatch = data;
+            break;
+        case 0xC001:
+            irqReload = true;
+            break;
+        case 0xE000:
+            //also acknowledges a pending IRQ
+            irqEnabled = false;
+            irq = false;
+            break;
+        case 0xE001:
+            irqEnabled = true;
+            break;
+    }
+}
+
+void MMC3::clockScanline() {
+    if (irqCounter == 0 || irqReload) {
+        irqCounter = irqLatch;
+        irqReload = false;
+    } else {
+        irqCounter--;
+    }
+    if (irqCounter == 0 && irqEnabled) {
+        irq = true;
+    }
+}
+
+int MMC3::scanlinesUntilIrq() {
+    if (!irqEnabled) {
+        return 0;
+    }
+    //a reload takes one clock, then the latch counts down
+    if (irqCounter == 0 || irqReload) {
+        return irqLatch + 1;
+    }
+    return irqCounter;
+}
+
+void MMC3::updateBanks() {
+    //bit 7 swaps the two 2kb banks with the four 1kb banks
+    int inversion = (bankSelect & 0x80) ? 4 : 0;
+    mapChr1k(0 ^ inversion, bankRegisters[0] & 0xFE);
+    mapChr1k(1 ^ inversion, bankRegisters[0] | 0x01);
+    mapChr1k(2 ^ inversion, bankRegisters[1] & 0xFE);
+    mapChr1k(3 ^ inversion, bankRegisters[1] | 0x01);
+    for (int i = 0; i < 4; i++) {
+        mapChr1k((4 + i) ^ inversion, bankRegisters[2 + i]);
+    }
+
+    //bit 6 swaps R6 at $8000 with the second to last bank at $C000, $A000 is always R7 and $E000 the last bank
+    if (bankSelect & 0x40) {
+        mapPrg8k(0, -2);
+        mapPrg8k(2, bankRegisters[6] & 0x3F);
+    } else {
+        mapPrg8k(0, bankRegisters[6] & 0x3F);
+        mapPrg8k(2, -2);
+    }
+    mapPrg8k(1, bankRegisters[7] & 0x3F);
+    mapPrg8k(3, -1);
+}
@@ -0,0 +1,101 @@
+// cartridge bank switching hardware
+#pragma once
+#include <cstdint>
+#include "Cartridge.h"
+
+//a mapper only rewrites the cartridge's bank tables when one of its registers is written, the emulator then
+//points the cpu and ppu page tables at the new banks so reads never have to ask the mapper anything
+class Mapper {
+public:
+    Mapper(Cartridge *cartridge);
+    virtual ~Mapper() {}
+
+    //mapper for an iNES mapper number, nullptr if it isnt supported
+    static Mapper *create(int number, Cartridge *cartridge);
+
+    //power on banks
+    virtual void reset();
+    //cpu write to $8000-$FFFF
+    virtual void write(uint16_t address, uint8_t data) {}
+
+    //boards that count scanlines by watching PPU A12. the emulator clocks them at the dots the ppu says A12 rises
+    //and asks ahead how many clocks until the next IRQ, so nothing polls the counter dot by dot
+    virtual bool hasScanlineCounter() { return false; }
+    virtual void clockScanline() {}
+    //clocks until irq goes high, 0 if it wont
+    virtual int scanlinesUntilIrq() { return 0; }
+    //IRQ output, held until the cpu acknowledges it through a mapper register
+    bool irq = false;
+
+protected:
+    Cartridge *cartridge;
+
+    //bank numbers are in units of the bank size and wrap around the rom like the unused high lines do
+    void mapPrg8k(int slot, int bank);
+    void mapPrg16k(int slot, int bank);
+    void mapPrg32k(int bank);
+    void mapChr1k(int slot, int bank);
+    void mapChr2k(int slot, int bank);
+    void mapChr4k(int slot, int bank);
+    void mapChr8k(int bank);
+    void setMirroring(Cartridge::Mirroring mirroring);
+};
+
+//mapper 1, SxROM
+class MMC1 : public Mapper {
+public:
+    MMC1(Cartridge *cartridge) : Mapper(cartridge) {}
+    void reset() override;
+    void write(uint16_t address, uint8_t data) override;
+
+private:
+    //registers are written one bit at a time, the fifth write moves the bits into the register
+    uint8_t shift = 0;
+    int shiftCount = 0;
+
+    uint8_t control = 0x0C;
+    uint8_t chrBank0 = 0;
+    uint8_t chrBank1 = 0;
+    uint8_t prgBank = 0;
+
+    void updateBanks();
+};
+
+//mapper 2, 16kb switchable at $8000 and the last 16kb fixed at $C000
+class UxROM : public Mapper {
+public:
+    UxROM(Cartridge *cartridge) : Mapper(cartridge) {}
+    void reset() override;
+    void write(uint16_t address, uint8_t data) override;
+};
+
+//mapper 3, switchable 8kb of CHR
+class CNROM : public Mapper {
+public:
+    CNROM(Cartridge *cartridge) : Mapper(cartridge) {}
+    void write(uint16_t address, uint8_t data) override;
+};
+
+//mapper 4, TxROM
+class MMC3 : public Mapper {
+public:
+    MMC3(Cartridge *cartridge) : Mapper(cartridge) {}
+    void reset() override;
+    void write(uint16_t address, uint8_t data) override;
+    bool hasScanlineCounter() override { return true; }
+    void clockScanline() override;
+    int scanlinesUntilIrq() override;
+
+private:
+    uint8_t bankSelect = 0;
+    //R0-R7
+    uint8_t bankRegisters[8];
+
+    //scanline counter, reloaded from the latch when it is 0 or a reload was asked for, IRQ when it ends up at 0
+    uint8_t irqLatch = 0;
+    uint8_t irqCounter = 0;
+    bool irqReload = false;
+    bool irqEnabled = false;
+
+    void updateBanks();
+};
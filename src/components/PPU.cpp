@@ -1,10 +1,21 @@
 #include "PPU.h"
 #include "../Emulator.h"
+#include "../Log.h"
 #include <cstdlib>
 #include <string.h>
+#include <algorithm>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+//the line compositor uses ssse3 shuffles for the palette lookup, picked at runtime since the build only assumes sse2
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define PPU_SSSE3
+#include <tmmintrin.h>
+#endif
 
 PPU::PPU(Emulator *emulator) {
     this->emulator = emulator;
+    frame.setPalette(paletteTranslationTable);
     cycle = 0;
     scanline = 0;
 }
@@ -47,6 +58,10 @@ void PPU::reset() {
 	shiftPattern.highWord = 0;
 	shiftAttribute.lowWord = 0;
 	shiftAttribute.highWord = 0;
+
+	spriteCount = 0;
+	memset(spriteLine, 0, sizeof(spriteLine));
+	spriteMoves = 0;
 }
 
 bool PPU::clock() {
@@ -54,19 +69,15 @@ bool PPU::clock() {
 	if (scanline == -1 && cycle == 1)
 	{
 		//clear vblank
-		PPUSTATUS.setValueRange(7,7,0);
+		PPUSTATUS.setVblank(false);
 
 		//sprite overflow flag
-		PPUSTATUS.setValueRange(5,5,0);
+		PPUSTATUS.setSpriteOverflow(false);
 		
 		//sprite zero hit
-		PPUSTATUS.setValueRange(6,6,0);
+		PPUSTATUS.setSpriteZeroHit(false);
 
-		for (int i = 0; i < 8; i++)
-		{
-			spriteLowShiftReg[i] = 0;
-			spriteHighShiftReg[i] = 0;
-		}
+		memset(spriteLine, 0, sizeof(spriteLine));
 	}
 
 	if (scanline >= -1 && scanline < 240)
@@ -85,15 +96,15 @@ bool PPU::clock() {
 	if (cycle == 340)
 	{
 		//prepares sprite info for rendering
-		updateSpriteShiftRegs();
+		buildSpriteLine();
 	}
 
 	if (scanline == 241 && cycle == 1)
 	{
 		//vblank
-		PPUSTATUS.setValueRange(7,7,1 << 7);
+		PPUSTATUS.setVblank(true);
 
-		if (PPUCTRL.getValueRange(7,7)) 
+		if (PPUCTRL.nmiEnable()) 
 			emulator->cpuNMI();
 	}
 	
@@ -117,7 +128,11 @@ bool PPU::clock() {
 			palette = foregroundPaletteIndex;
 		}
 
-		emulator->pixelBuffer->writeBufferPixel(cycle - 1, scanline, paletteTranslationTable[emulator->ppuBusRead(0x3F00 + (palette << 2) + pixel)]);
+		//cycle 0 draws the last pixel of the line above, there is none above the first line
+		if (cycle > 0 || scanline > 0) {
+			frame.pixels[scanline * DEFAULT_WIDTH + cycle - 1] = palettes[(palette << 2) + pixel] & 0x3F;
+		}
+		frame.emphasis[scanline] = PPUMASK.emphasis();
 	}
 
 	cycle++;
@@ -142,8 +157,326 @@ bool PPU::clock() {
     return false;
 }
 
+static int framePosition(int scanline, int cycle) {
+	//dot index within the frame, scanline 0 is the only one that starts on cycle 0 after the prerender line (see clock)
+	if (scanline <= 0) {
+		return (scanline + 1) * 341 + cycle;
+	}
+	return (scanline + 1) * 341 + cycle - 1;
+}
+
+int PPU::dotsUntilEvent() {
+	int position = framePosition(scanline, cycle);
+
+	//clock returns true for the frame on the last dot of scanline 260
+	int frameEnd = framePosition(260, 340) - position;
+
+	if (PPUCTRL.nmiEnable()) {
+		int vblank = framePosition(241, 1) - position;
+		if (vblank >= 0 && vblank < frameEnd) {
+			return vblank;
+		}
+	}
+	return frameEnd;
+}
+
+int PPU::scanlineClockCycle() {
+	if (!PPUMASK.showBg() && !PPUMASK.showSprites()) {
+		return -1;
+	}
+	//sprite fetches (257-320) come before the next line's first background fetches (321-336)
+	if (PPUCTRL.spritePatternBase() || PPUCTRL.tallSprites()) {
+		return 260;
+	}
+	if (PPUCTRL.backgroundPatternBase()) {
+		return 324;
+	}
+	return -1;
+}
+
+long long PPU::dotsToScanlineClock(long long after) {
+	int clockCycle = scanlineClockCycle();
+	const int frameDots = framePosition(260, 340) + 1;
+	long long now = framePosition(scanline, cycle);
+	long long position = now + after;
+	int inFrame = ((position % frameDots) + frameDots) % frameDots;
+	long long frameStart = position - inFrame;
+
+	//the prerender line and every visible line clock once
+	int next;
+	if (inFrame < framePosition(-1, clockCycle)) {
+		next = framePosition(-1, clockCycle);
+	} else if (inFrame < framePosition(0, clockCycle)) {
+		next = framePosition(0, clockCycle);
+	} else {
+		int line = (inFrame - framePosition(0, clockCycle) + 1) / 341 + 1;
+		next = line < 240 ? framePosition(line, clockCycle) : framePosition(-1, clockCycle) + frameDots;
+	}
+	return frameStart + next - now;
+}
+
+int PPU::scanlineDots() {
+	//scanline 1 starts on cycle 1 (see clock)
+	int firstCycle = scanline == 1 ? 1 : 0;
+	if (scanline < 0 || scanline >= 240 || cycle != firstCycle) {
+		return 0;
+	}
+	return 341 - firstCycle;
+}
+
+void PPU::runScanline() {
+	switch (renderMode) {
+		case RENDER_SCANLINE:
+			renderScanline();
+			break;
+		case RENDER_VERIFY:
+			verifyScanline();
+			break;
+		default:
+			for (int dots = scanlineDots(); dots > 0; dots--) {
+				clock();
+			}
+			break;
+	}
+}
+
+//pixel x of a line is background[x], unless sprites[x] is opaque. the clip flags hide the leftmost 8 pixels of a layer.
+//writes the nes color of all 256 pixels to out and returns true if sprite 0 drew one of the first 255
+static bool composeLineScalar(const uint8_t *background, const PPU::SpritePixel *sprites, bool clipBackground, bool clipSprites, const uint8_t *palettes, uint8_t *out) {
+	bool spriteZeroHit = false;
+	for (int x = 0; x < DEFAULT_WIDTH; x++) {
+		uint8_t color = (clipBackground && x < 8) ? 0 : background[x];
+		const PPU::SpritePixel &sprite = sprites[x];
+		if (sprite.pixel != 0 && !(clipSprites && x < 8)) {
+			color = (sprite.palette << 2) | sprite.pixel;
+			spriteZeroHit |= sprite.spriteZero && x < DEFAULT_WIDTH - 1;
+		}
+		out[x] = palettes[color] & 0x3F;
+	}
+	return spriteZeroHit;
+}
+
+#ifdef PPU_SSSE3
+__attribute__((target("ssse3")))
+static bool composeLineSSSE3(const uint8_t *background, const PPU::SpritePixel *sprites, bool clipBackground, bool clipSprites, const uint8_t *palettes, uint8_t *out) {
+	const __m128i paletteLow = _mm_loadu_si128((const __m128i *)palettes);
+	const __m128i paletteHigh = _mm_loadu_si128((const __m128i *)(palettes + 16));
+	const __m128i byteMask = _mm_set1_epi32(0xFF);
+	const __m128i zero = _mm_setzero_si128();
+	//lanes 0-7 cleared, for the left column
+	const __m128i leftClip = _mm_set_epi64x(-1, 0);
+	//lane 15 cleared, pixel 255 doesnt count for sprite 0 on this line
+	const __m128i lastPixel = _mm_srli_si128(_mm_set1_epi8(-1), 1);
+	__m128i spriteZero = zero;
+
+	for (int x = 0; x < DEFAULT_WIDTH; x += 16) {
+		__m128i color = _mm_loadu_si128((const __m128i *)(background + x));
+
+		//4 sprite pixels per load, byte 0 is the pixel, byte 1 the palette and byte 3 the sprite 0 flag
+		__m128i spriteColor[4];
+		__m128i spriteFlag[4];
+		for (int i = 0; i < 4; i++) {
+			__m128i entries = _mm_loadu_si128((const __m128i *)(sprites + x + i * 4));
+			spriteColor[i] = _mm_or_si128(_mm_and_si128(entries, byteMask), _mm_slli_epi32(_mm_and_si128(_mm_srli_epi32(entries, 8), byteMask), 2));
+			spriteFlag[i] = _mm_srli_epi32(entries, 24);
+		}
+		__m128i sprite = _mm_packus_epi16(_mm_packs_epi32(spriteColor[0], spriteColor[1]), _mm_packs_epi32(spriteColor[2], spriteColor[3]));
+		__m128i flags = _mm_packus_epi16(_mm_packs_epi32(spriteFlag[0], spriteFlag[1]), _mm_packs_epi32(spriteFlag[2], spriteFlag[3]));
+
+		if (x == 0) {
+			if (clipBackground) color = _mm_and_si128(color, leftClip);
+			if (clipSprites) {
+				sprite = _mm_and_si128(sprite, leftClip);
+				flags = _mm_and_si128(flags, leftClip);
+			}
+		}
+		if (x == DEFAULT_WIDTH - 16) {
+			flags = _mm_and_si128(flags, lastPixel);
+		}
+
+		//transparent sprite pixels have 0 in the low 2 bits
+		__m128i transparent = _mm_cmpeq_epi8(_mm_and_si128(sprite, _mm_set1_epi8(0x03)), zero);
+		color = _mm_or_si128(_mm_and_si128(transparent, color), _mm_andnot_si128(transparent, sprite));
+		spriteZero = _mm_or_si128(spriteZero, _mm_andnot_si128(transparent, flags));
+
+		//palette ram is 32 bytes, bit 4 of the color picks the half to shuffle from
+		__m128i index = _mm_and_si128(color, _mm_set1_epi8(0x0F));
+		__m128i upper = _mm_cmpeq_epi8(_mm_and_si128(color, _mm_set1_epi8(0x10)), _mm_set1_epi8(0x10));
+		__m128i result = _mm_or_si128(_mm_andnot_si128(upper, _mm_shuffle_epi8(paletteLow, index)), _mm_and_si128(upper, _mm_shuffle_epi8(paletteHigh, index)));
+		_mm_storeu_si128((__m128i *)(out + x), _mm_and_si128(result, _mm_set1_epi8(0x3F)));
+	}
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(spriteZero, zero)) != 0xFFFF;
+}
+#endif
+
+static bool composeLine(const uint8_t *background, const PPU::SpritePixel *sprites, bool clipBackground, bool clipSprites, const uint8_t *palettes, uint8_t *out) {
+#ifdef PPU_SSSE3
+	static const bool ssse3 = __builtin_cpu_supports("ssse3");
+	if (ssse3) {
+		return composeLineSSSE3(background, sprites, clipBackground, clipSprites, palettes, out);
+	}
+#endif
+	return composeLineScalar(background, sprites, clipBackground, clipSprites, palettes, out);
+}
+
+void PPU::renderScanline() {
+	//same result as running the line through clock, but the mask, control and scroll registers cant change
+	//mid line so every per dot check is done once, and tiles come out of the tile cache 8 pixels at a time
+
+	bool showBackground = PPUMASK.showBg();
+	bool showSprites = PPUMASK.showSprites();
+	//sprites only count down and shift while the background is on
+	bool spritesMove = showBackground && showSprites;
+	int firstCycle = cycle;
+	Cartridge *cartridge = emulator->cartridge;
+	TileCache &tiles = *cartridge->tiles;
+
+	//background for the whole line, palette << 2 | pixel for the 2 prefetched tiles in the shift registers and the
+	//32 fetched during the line. pixel x shows entry x + fine x, the shift registers never need to move
+	uint8_t background[34 * 8] = {0};
+	if (showBackground) {
+		for (int i = 0; i < 16; i++) {
+			int bit = 15 - i;
+			background[i] = (((shiftAttribute.highWord >> bit) & 1) << 3) | (((shiftAttribute.lowWord >> bit) & 1) << 2) |
+							(((shiftPattern.highWord >> bit) & 1) << 1) | ((shiftPattern.lowWord >> bit) & 1);
+		}
+	}
+	uint16_t patternBase = PPUCTRL.backgroundPatternBase();
+
+	//cycles 2-257, one tile fetch per group of 8
+	for (int group = 0; group < 32; group++) {
+		loadTileInfo(2);
+		if (showBackground) {
+			//the attribute goes into every byte next to the 8 pixels of the row
+			uint64_t pixels = tiles.row(cartridge->chrAddress(patternBase + (next_tile.id << 4) + vramAddress.fineY())) | (next_tile.attribute * 0x0404040404040404ULL);
+			uint8_t *tile = background + (group + 2) * 8;
+			for (int x = 0; x < 8; x++) {
+				tile[x] = pixels >> (x * 8);
+			}
+		} else {
+			//nothing is drawn, but the fetched bytes still pile up in the shift registers like they do dot by dot
+			loadTileInfo(4);
+			loadTileInfo(6);
+		}
+		loadTileInfo(7);
+		if (group == 31) {
+			//cycle 256
+			if (showBackground || showSprites) {
+				vramAddress.increment(AXIS_Y);
+			}
+		}
+		if (showBackground) {
+			//the shift registers are flushed by the prefetch, only the next tile id matters
+			next_tile.id = emulator->ppuBusRead(0x2000 | (vramAddress.getValue() & 0x0FFF));
+		} else {
+			loadTileInfo(0);
+		}
+	}
+
+	//sprites are read by how far they have moved, that is x when they move every cycle and 0 when they are held
+	static const SpritePixel noSprites[256] = {};
+	SpritePixel heldSprites[256];
+	const SpritePixel *sprites = spriteLine;
+	if (!showSprites) {
+		sprites = noSprites;
+	} else if (!spritesMove) {
+		std::fill(heldSprites, heldSprites + 256, spriteLine[0]);
+		sprites = heldSprites;
+	}
+
+	uint8_t *buffer = frame.pixels + scanline * DEFAULT_WIDTH;
+	frame.emphasis[scanline] = PPUMASK.emphasis();
+
+	//cycle 0 draws the last pixel of the line above, out of this line's first background and sprite pixel
+	if (firstCycle == 0) {
+		uint8_t color = background[fineXScroll];
+		if (sprites[0].pixel != 0) {
+			color = (sprites[0].palette << 2) | sprites[0].pixel;
+			if (sprites[0].spriteZero) PPUSTATUS.setSpriteZeroHit(true);
+		}
+		if (scanline > 0) {
+			buffer[-1] = palettes[color] & 0x3F;
+		}
+	}
+
+	//cycles 1-255 draw pixels 0-254, pixel 255 is drawn by cycle 0 of the next line
+	uint8_t line[DEFAULT_WIDTH];
+	if (composeLine(background + fineXScroll, sprites, !PPUMASK.showBgLeft(), !PPUMASK.showSpritesLeft(), palettes, line)) {
+		PPUSTATUS.setSpriteZeroHit(true);
+	}
+	memcpy(buffer, line, DEFAULT_WIDTH - 1);
+
+	//cycle 257
+	if (showBackground || showSprites) {
+		vramAddress.sync(tempVramAddress, AXIS_X);
+	}
+	prepareScanlineSpriteInfo();
+
+	//cycles 321-337 prefetch the first two tiles of the next line
+	for (int c = 321; c < 338; c++) {
+		if (showBackground) {
+			shiftPattern.shift();
+			shiftAttribute.shift();
+		}
+		loadTileInfo((c - 1) % 8);
+	}
+
+	//cycles 338 and 340
+	next_tile.id = emulator->ppuBusRead(0x2000 | (vramAddress.getValue() & 0x0FFF));
+	buildSpriteLine();
+
+	cycle = 0;
+	scanline++;
+	if (scanline == 1) {
+		cycle = 1;
+	}
+}
+
+void PPU::verifyScanline() {
+	//renders the line with the scanline renderer, rewinds and renders it again dot by dot, the dot result is kept
+	uint8_t *buffer = frame.pixels;
+	//the line writes from the last pixel of the line above up to its own second last pixel
+	int first = scanline > 0 ? scanline * DEFAULT_WIDTH - 1 : 0;
+	int last = scanline * DEFAULT_WIDTH + DEFAULT_WIDTH - 1;
+	int line = scanline;
+
+	PPU before = *this;
+	renderScanline();
+	PPU scanlineResult = *this;
+	uint8_t scanlinePixels[DEFAULT_WIDTH + 1];
+	memcpy(scanlinePixels, buffer + first, last - first);
+
+	*this = before;
+	for (int dots = scanlineDots(); dots > 0; dots--) {
+		clock();
+	}
+
+	scanlinesVerified++;
+
+	int pixelMismatch = -1;
+	for (int i = first; i < last; i++) {
+		if (buffer[i] != scanlinePixels[i - first]) {
+			pixelMismatch = i - line * DEFAULT_WIDTH;
+			break;
+		}
+	}
+	bool stateMatch = scanlineResult.vramAddress.getValue() == vramAddress.getValue() &&
+					  scanlineResult.PPUSTATUS.getValue() == PPUSTATUS.getValue() &&
+					  scanlineResult.shiftPattern.lowWord == shiftPattern.lowWord && scanlineResult.shiftPattern.highWord == shiftPattern.highWord &&
+					  scanlineResult.shiftAttribute.lowWord == shiftAttribute.lowWord && scanlineResult.shiftAttribute.highWord == shiftAttribute.highWord &&
+					  memcmp(&scanlineResult.next_tile, &next_tile, sizeof(TileInfo)) == 0 &&
+					  scanlineResult.spriteCount == spriteCount && scanlineResult.scanline == scanline && scanlineResult.cycle == cycle;
+
+	if (pixelMismatch >= 0 || !stateMatch) {
+		scanlineMismatches++;
+		logPrintf(RED "PPU: Scanline %i differs from dot renderer, first pixel %i, v 0x%04X vs 0x%04X, status %02X vs %02X\n" RESET,
+			   line, pixelMismatch, scanlineResult.vramAddress.getValue(), vramAddress.getValue(), scanlineResult.PPUSTATUS.getValue(), PPUSTATUS.getValue());
+	}
+}
+
 void PPU::getBackgroundPixelColor(uint8_t *index, uint8_t *palette) {
-	if (PPUMASK.getValueRange(3,3))
+	//cycles 1-8 draw the left column
+	if (PPUMASK.showBg() && (cycle < 1 || cycle > 8 || PPUMASK.showBgLeft()))
 	{
 		uint16_t mask = 1 << (15 - fineXScroll);
 
@@ -154,25 +487,15 @@ void PPU::getBackgroundPixelColor(uint8_t *index, uint8_t *palette) {
 }
 
 void PPU::getForegroundPixelColor(uint8_t *foregroundPixelIndex, uint8_t *foregroundPaletteIndex, uint8_t *foregroundPriority) {
-	if ((PPUMASK.getValueRange(4,4) >> 4))
+	if (PPUMASK.showSprites() && (cycle < 1 || cycle > 8 || PPUMASK.showSpritesLeft()))
 	{
-		//check all sprites
-		for (uint8_t i = 0; i < spriteCount; i++)
-		{
-			//this means its time to render
-			if (spriteInfoBuffer[i].x == 0) 
-			{
-				*foregroundPixelIndex = (((spriteHighShiftReg[i] & 0x80) >> 7) << 1) | ((spriteLowShiftReg[i] & 0x80) >> 7);
-				*foregroundPaletteIndex = (spriteInfoBuffer[i].attributes & 0x03) + 0x04;
-				*foregroundPriority = (spriteInfoBuffer[i].attributes & 0x20) == 0;
-
-				if (*foregroundPixelIndex != 0)
-				{
-					if (i == 0) PPUSTATUS.setValueRange(6,6, 1 << 6);
-					break;
-				}				
-			}
-		}		
+		//the sprite line already holds the first opaque sprite for every position
+		SpritePixel &sprite = spriteLine[spriteMoves];
+		*foregroundPixelIndex = sprite.pixel;
+		*foregroundPaletteIndex = sprite.palette;
+		*foregroundPriority = sprite.priority;
+
+		if (sprite.spriteZero) PPUSTATUS.setSpriteZeroHit(true);
 	}
 }
 
@@ -182,17 +505,14 @@ void PPU::visiblePixelInfoCycle() {
 	if ((cycle >= 2 && cycle < 258) || (cycle >= 321 && cycle < 338))
 	{
 		//shift registers
-		if (PPUMASK.getValueRange(3,3))
+		if (PPUMASK.showBg())
 		{
 			shiftPattern.shift();
 			shiftAttribute.shift();
 
-			if ((PPUMASK.getValueRange(4,4) >> 4) && cycle >= 1 && cycle < 258)
+			if (PPUMASK.showSprites() && cycle >= 1 && cycle < 258)
 			{
-				for (int i = 0; i < spriteCount; i++)
-				{
-					spriteInfoBuffer[i].x > 0 ? spriteInfoBuffer[i].x-- : (spriteLowShiftReg[i] <<= 1, spriteHighShiftReg[i] <<= 1);
-				}
+				spriteMoves++;
 			}
 		}
 		//different values of the nextTile information are loaded depending on how deep we are in the loop
@@ -202,22 +522,22 @@ void PPU::visiblePixelInfoCycle() {
 	if (cycle == 256)
 	{
 		//rendering check
-		if (PPUMASK.getValueRange(3,3) || PPUMASK.getValueRange(4,4)) {
+		if (PPUMASK.renderingEnabled()) {
 			//scanline is done so move y
-			vramAddress.incrementAddress('y');
+			vramAddress.increment(AXIS_Y);
 		}
 	}
 
 	if (cycle == 257)
 	{
 		//load next tile information into shift regs
-		shiftPattern.loadNextTile(next_tile,'p');
-		shiftAttribute.loadNextTile(next_tile,'a');
+		shiftPattern.loadNextTile(next_tile, SHIFTREG::PATTERN);
+		shiftAttribute.loadNextTile(next_tile, SHIFTREG::ATTRIBUTE);
 
 		//if rendering is enabled (For  background or for sprites)
-		if (PPUMASK.getValueRange(3,3) || PPUMASK.getValueRange(4,4)) {
+		if (PPUMASK.renderingEnabled()) {
 			//hblank, update v register
-			vramAddress.syncAddress(tempVramAddress, 'x');
+			vramAddress.sync(tempVramAddress, AXIS_X);
 		}
 	}
 
@@ -229,11 +549,37 @@ void PPU::visiblePixelInfoCycle() {
 	if (scanline == -1 && cycle >= 280 && cycle < 305)
 	{
 		//if rendering is enabled
-		if (PPUMASK.getValueRange(3,3) || PPUMASK.getValueRange(4,4)) {
+		if (PPUMASK.renderingEnabled()) {
 			//update y information
-			vramAddress.syncAddress(tempVramAddress, 'y');
+			vramAddress.sync(tempVramAddress, AXIS_Y);
+		}
+	}
+}
+
+static uint64_t spritesOnLine(const PPU::OAMentry *oam, int scanline, int height) {
+	//bit i is set when sprite i is between scanline and scanline + height of sprite
+	uint64_t onLine = 0;
+#if defined(__SSE2__) || defined(_M_X64)
+	//4 oam entries per 16 bytes with y in the low byte of each 32 bit lane, scanline - y has to land in [0, height)
+	const __m128i line = _mm_set1_epi32(scanline);
+	const __m128i yMask = _mm_set1_epi32(0xFF);
+	const __m128i above = _mm_set1_epi32(-1);
+	const __m128i below = _mm_set1_epi32(height);
+	for (int i = 0; i < 64; i += 4) {
+		__m128i entries = _mm_loadu_si128((const __m128i *)(oam + i));
+		__m128i row = _mm_sub_epi32(line, _mm_and_si128(entries, yMask));
+		__m128i hit = _mm_and_si128(_mm_cmpgt_epi32(row, above), _mm_cmplt_epi32(row, below));
+		onLine |= (uint64_t)_mm_movemask_ps(_mm_castsi128_ps(hit)) << i;
+	}
+#else
+	for (int i = 0; i < 64; i++) {
+		int row = scanline - oam[i].y;
+		if (row >= 0 && row < height) {
+			onLine |= (uint64_t)1 << i;
 		}
 	}
+#endif
+	return onLine;
 }
 
 void PPU::prepareScanlineSpriteInfo() {
@@ -245,55 +591,65 @@ void PPU::prepareScanlineSpriteInfo() {
 
 	spriteCount = 0;
 
-	for (uint8_t i = 0; i < 8; i++)
-	{
-		spriteLowShiftReg[i] = 0;
-		spriteHighShiftReg[i] = 0;
-	}
+	uint64_t onLine = spritesOnLine(OAM, scanline, PPUCTRL.tallSprites() ? 16 : 8);
 
-	for (uint8_t i = 0; i < 64; i++)
+	for (uint8_t i = 0; i < 64 && onLine != 0; i++, onLine >>= 1)
 	{
-		//max sprite overflow
-		if (spriteCount > 8) break;
+		if (!(onLine & 1)) continue;
 
-		//check if sprite is between scanline and scanline + height of sprite
-		if ((scanline - OAM[i].y) >= 0 && (scanline - OAM[i].y) < ((PPUCTRL.getValueRange(5,5) >> 5) ? 16 : 8))
-		{
-			spriteInfoBuffer[spriteCount] = OAM[i];
-			spriteCount++;
+		//sprite overflow, only 8 fit on a line
+		if (spriteCount == 8) {
+			PPUSTATUS.setSpriteOverflow(true);
+			break;
 		}
+		spriteInfoBuffer[spriteCount] = OAM[i];
+		spriteCount++;
 	}
-
-	PPUSTATUS.setValueRange(5,5,(spriteCount > 8));
 }
 
-void PPU::updateSpriteShiftRegs() {
-	uint8_t spriteIndex = 0;
-    while (spriteIndex < spriteCount) {
-        OAMentry &currentSprite = spriteInfoBuffer[spriteIndex];
+void PPU::buildSpriteLine() {
+	Cartridge *cartridge = emulator->cartridge;
+	TileCache &tiles = *cartridge->tiles;
+	bool tallSprites = PPUCTRL.tallSprites();
 
-		//calculate where current sprite info is
-        uint16_t spriteLowAddress = ((PPUCTRL.getValueRange(3,3) >> 3) << 12) | (currentSprite.spriteIndex << 4) | ((currentSprite.attributes & 0x80) ? 7 - (scanline - currentSprite.y) : scanline - currentSprite.y);
-        uint16_t spriteHighAddress = spriteLowAddress + 8;
-		
-		//load into shifters
-        spriteLowShiftReg[spriteIndex] = emulator->ppuBusRead(spriteLowAddress);
-        spriteHighShiftReg[spriteIndex] = emulator->ppuBusRead(spriteHighAddress);
-
-		//flip if attribute says so
-        if (currentSprite.attributes & 0x40) {
-            uint8_t lowFlip = 0;
-            uint8_t highFlip = 0;
-            for (int i = 0; i < 8; i++) {
-                lowFlip |= ((spriteLowShiftReg[spriteIndex] >> i) & 1) << (7 - i);
-                highFlip |= ((spriteHighShiftReg[spriteIndex] >> i) & 1) << (7 - i);
-            }
-            spriteLowShiftReg[spriteIndex] = lowFlip;
-            spriteHighShiftReg[spriteIndex] = highFlip;
-        }
-
-        spriteIndex++;
-    }
+	memset(spriteLine, 0, sizeof(spriteLine));
+	spriteMoves = 0;
+
+	//last sprite first, so lower indexes end up on top
+	for (int spriteIndex = spriteCount - 1; spriteIndex >= 0; spriteIndex--) {
+		OAMentry &currentSprite = spriteInfoBuffer[spriteIndex];
+
+		//row of the sprite on this line, flipped vertically if the attribute says so
+		int row = scanline - currentSprite.y;
+		if (currentSprite.attributes & 0x80) {
+			row = (tallSprites ? 15 : 7) - row;
+		}
+
+		//sprites picked up on the last vblank line land on the prerender line, they have nothing to draw
+		if (row < 0 || row >= (tallSprites ? 16 : 8)) {
+			continue;
+		}
+
+		//8x16 sprites take their pattern table from bit 0 of the index and cover two tiles
+		uint16_t address;
+		if (tallSprites) {
+			address = ((currentSprite.spriteIndex & 0x01) << 12) | ((currentSprite.spriteIndex & 0xFE) << 4) | ((row & 0x08) << 1) | (row & 0x07);
+		} else {
+			address = PPUCTRL.spritePatternBase() | (currentSprite.spriteIndex << 4) | row;
+		}
+
+		//horizontal flip comes pre-decoded
+		int chrAddress = cartridge->chrAddress(address);
+		uint64_t pixels = (currentSprite.attributes & 0x40) ? tiles.flippedRow(chrAddress) : tiles.row(chrAddress);
+
+		SpritePixel sprite = {0, (uint8_t)((currentSprite.attributes & 0x03) + 0x04), (currentSprite.attributes & 0x20) == 0, spriteIndex == 0};
+		for (int i = 0; i < 8 && currentSprite.x + i < 256; i++, pixels >>= 8) {
+			sprite.pixel = pixels & 0x03;
+			if (sprite.pixel != 0) {
+				spriteLine[currentSprite.x + i] = sprite;
+			}
+		}
+	}
 }
 
 void PPU::loadTileInfo(uint8_t step) {
@@ -301,8 +657,8 @@ void PPU::loadTileInfo(uint8_t step) {
 		//load namertable byte
 
 		//load next tile information into shift regs
-		shiftPattern.loadNextTile(next_tile,'p');
-		shiftAttribute.loadNextTile(next_tile,'a');
+		shiftPattern.loadNextTile(next_tile, SHIFTREG::PATTERN);
+		shiftAttribute.loadNextTile(next_tile, SHIFTREG::ATTRIBUTE);
 
 		next_tile.id = emulator->ppuBusRead(0x2000 | (vramAddress.getValue() & 0x0FFF));
 
@@ -310,26 +666,26 @@ void PPU::loadTileInfo(uint8_t step) {
 
 		//load attribute table byte
 		next_tile.attribute = emulator->ppuBusRead(0x23C0 | (vramAddress.getValue() & 0x0C00) | ((vramAddress.getValue() & 0x0380) >> 4) | ((vramAddress.getValue() & 0x001C) >> 2));
-		next_tile.attribute >>= ((vramAddress.getValueRange(5,9) & 0x40) ? 4 : 0);
-		next_tile.attribute >>= ((vramAddress.getValueRange(0,4) & 0x02) ? 2 : 0);
+		next_tile.attribute >>= ((vramAddress.coarseY() & 0x02) ? 4 : 0);
+		next_tile.attribute >>= ((vramAddress.coarseX() & 0x02) ? 2 : 0);
 		next_tile.attribute &= 0b11;
 
 	} else if (step == 4) {
 
 		//load background pattern table lsb
-		next_tile.lsb = emulator->ppuBusRead(((PPUCTRL.getValueRange(4,4) >> 4) * 0x1000) + (next_tile.id << 4) + (vramAddress.getValueRange(12,14) >> 12));
+		next_tile.lsb = emulator->ppuBusRead(PPUCTRL.backgroundPatternBase() + (next_tile.id << 4) + vramAddress.fineY());
 	
 	} else if (step == 6) {
 
 		//background pattern table msb
-		next_tile.msb = emulator->ppuBusRead(((PPUCTRL.getValueRange(4,4) >> 4) * 0x1000) + (next_tile.id << 4) + (vramAddress.getValueRange(12,14) >> 12) + 8);
+		next_tile.msb = emulator->ppuBusRead(PPUCTRL.backgroundPatternBase() + (next_tile.id << 4) + vramAddress.fineY() + 8);
 	
 	} else if (step == 7) {
 
 		//rendering enable check
-		if (PPUMASK.getValueRange(3,3) || PPUMASK.getValueRange(4,4)) {
+		if (PPUMASK.renderingEnabled()) {
 			//move to next tile
-			vramAddress.incrementAddress('x');
+			vramAddress.increment(AXIS_X);
 		}
 	}
 }
@@ -347,7 +703,7 @@ uint8_t PPU::readRegisters(uint16_t address) {
             data = PPUSTATUS.getValue();
 
             //status write side effects 
-			PPUSTATUS.setValueRange(7,7,1 << 7);
+			PPUSTATUS.setVblank(true);
 			writeToggle = 0;
 			break;
 		case 0x2003: break;
@@ -377,8 +733,7 @@ void PPU::writeRegisters(uint16_t address, uint8_t data) {
 	case 0x2000:
         //PPUCTRL
 		PPUCTRL.setValue(data);
-		tempVramAddress.setValueRange(10,10,PPUCTRL.getValueRange(0,0) << 10);
-		tempVramAddress.setValueRange(11,11,PPUCTRL.getValueRange(1,1) << 10);
+		tempVramAddress.setNametable(PPUCTRL.nametable());
 		break;
 	case 0x2001:
         //PPUMASK
@@ -400,13 +755,13 @@ void PPU::writeRegisters(uint16_t address, uint8_t data) {
 		if (writeToggle == 0)
 		{
 			fineXScroll = data & 0x07;
-			tempVramAddress.setValueRange(0,4,data >> 3);
+			tempVramAddress.setCoarseX(data >> 3);
 			writeToggle = 1;
 		}
 		else
 		{
-			tempVramAddress.setValueRange(12,14, (data & 0x07) << 12);
-			tempVramAddress.setValueRange(5,9,(data >> 3) << 5);
+			tempVramAddress.setFineY(data & 0x07);
+			tempVramAddress.setCoarseY(data >> 3);
 			writeToggle = 0;
 		}
 		break;
@@ -427,7 +782,7 @@ void PPU::writeRegisters(uint16_t address, uint8_t data) {
 	case 0x2007:
         //PPUDATA
 		emulator->ppuBusWrite(vramAddress.getValue(), data);
-		vramAddress.setValue(vramAddress.getValue() + (PPUCTRL.getValueRange(2,2) ? 32 : 1));
+		vramAddress.setValue(vramAddress.getValue() + PPUCTRL.increment());
 		break;
 	}
 }
\ No newline at end of file
@@ -2,9 +2,9 @@
 #pragma once
 #include <cstdint>
 #include <vector>
-#include "../registerTypes/reg8.h"
-#include "../registerTypes/reg16.h"
+#include "../registerTypes/ppuRegisters.h"
 #include "../registerTypes/shiftReg.h"
+#include "FrameBuffer.h"
 
 class Emulator;
 
@@ -17,17 +17,42 @@ public:
 
     bool clock();
 
+    //dots until the ppu next does something the cpu can observe without touching a register (vblank NMI or frame end)
+    int dotsUntilEvent();
+
+    //cycle of a rendered line where pattern fetches first move from $0xxx to $1xxx, which is when a mapper's scanline
+    //counter is clocked. -1 while rendering is off or both layers fetch from the same table
+    int scanlineClockCycle();
+    //dots from now to the first of those clocks more than after dots away, after and the result can be negative
+    long long dotsToScanlineClock(long long after);
+
+    //scanline renderer, draws a whole visible line in one call when nothing touches the ppu before the line ends
+    //dot renders every line through clock, verify runs both renderers on every line and keeps the dot result
+    enum RenderMode {
+        RENDER_DOT,
+        RENDER_SCANLINE,
+        RENDER_VERIFY
+    };
+    int renderMode = RENDER_SCANLINE;
+    int scanlinesVerified = 0;
+    int scanlineMismatches = 0;
+
+    //dots left in the current line if it is a visible line that hasnt started yet, otherwise 0
+    int scanlineDots();
+    //runs exactly scanlineDots() dots
+    void runScanline();
+
     //cpu interaction
     uint8_t readRegisters(uint16_t address);
     void writeRegisters(uint16_t address, uint8_t data);
 
 	//ppu registers
-	REG8 PPUSTATUS = REG8();
-	REG8 PPUMASK = REG8();
-	REG8 PPUCTRL = REG8();
+	STATUSREG PPUSTATUS = STATUSREG();
+	MASKREG PPUMASK = MASKREG();
+	CTRLREG PPUCTRL = CTRLREG();
 
-	REG16 vramAddress = REG16();
-	REG16 tempVramAddress = REG16();
+	VRAMADDR vramAddress = VRAMADDR();
+	VRAMADDR tempVramAddress = VRAMADDR();
 
 	uint8_t fineXScroll = 0x00;
 
@@ -69,15 +94,29 @@ public:
 
 	//for each sprite maximum of 8
 	OAMentry spriteInfoBuffer[8];
-	uint8_t spriteLowShiftReg[8];
-	uint8_t spriteHighShiftReg[8];
+
+	//what the sprites draw on the next line, built once per line from spriteInfoBuffer. indexed by how many times the
+	//sprites have moved so far (once per dot while both layers are on), so the sprite x counters never have to tick
+	struct SpritePixel {
+		uint8_t pixel;
+		uint8_t palette;
+		uint8_t priority;
+		uint8_t spriteZero;
+	};
+	SpritePixel spriteLine[256];
+	uint16_t spriteMoves = 0;
 
 	//rendering functions
 	void getBackgroundPixelColor(uint8_t *pixelIndex, uint8_t *paletteindex);
 	void getForegroundPixelColor(uint8_t *foregroundPixelIndex, uint8_t *foregroundPaletteIndex, uint8_t *foregroundPriority);
 	void visiblePixelInfoCycle();
 	void prepareScanlineSpriteInfo();
-	void updateSpriteShiftRegs();
+	void buildSpriteLine();
+	void renderScanline();
+	void verifyScanline();
+
+    //what the ppu has drawn, as nes colors
+    FrameBuffer frame;
 
     //palette table, for translating the indexes stored in the nes to rgba values
     //copied from html of https://www.nesdev.org/wiki/PPU_palettes, 2C02
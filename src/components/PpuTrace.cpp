@@ -0,0 +1,84 @@
+#include "PpuTrace.h"
+#include "../Log.h"
+#include "../Definitions.h"
+#include <cstdio>
+#include <cstring>
+
+static const char TRACE_MAGIC[8] = {'N', 'E', 'S', 'P', 'P', 'U', 'T', 0};
+//bumped whenever State or Event change layout
+static const uint32_t TRACE_VERSION = 1;
+
+struct TraceHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t eventCount;
+    //sizes of the records, so a file from a build with different padding is refused
+    uint32_t stateSize;
+    uint32_t eventSize;
+    uint32_t frameDots;
+    uint32_t padding;
+    uint64_t frameHash;
+};
+
+int PpuTrace::save(const char *path) const {
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL) {
+        logPrintf(RED "PpuTrace: Could not write %s\n" RESET, path);
+        return 1;
+    }
+    TraceHeader header = {};
+    memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+    header.version = TRACE_VERSION;
+    header.eventCount = events.size();
+    header.stateSize = sizeof(State);
+    header.eventSize = sizeof(Event);
+    header.frameDots = frameDots;
+    header.frameHash = frameHash;
+
+    bool written = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+        fwrite(&state, sizeof(State), 1, fp) == 1 &&
+        fwrite(events.data(), sizeof(Event), events.size(), fp) == events.size();
+    if (fclose(fp) != 0 || !written) {
+        logPrintf(RED "PpuTrace: Could not write %s\n" RESET, path);
+        return 1;
+    }
+    return 0;
+}
+
+int PpuTrace::load(const char *path) {
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) {
+        logPrintf(RED "PpuTrace: Could not open %s\n" RESET, path);
+        return 1;
+    }
+    TraceHeader header;
+    if (fread(&header, sizeof(header), 1, fp) != 1 || memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != TRACE_VERSION || header.stateSize != sizeof(State) || header.eventSize != sizeof(Event)) {
+        logPrintf(RED "PpuTrace: %s is not a trace this build can read\n" RESET, path);
+        fclose(fp);
+        return 1;
+    }
+    //the count comes from the file, dont allocate for more events than the file holds
+    long start = ftell(fp);
+    bool sized = fseek(fp, 0, SEEK_END) == 0;
+    long end = ftell(fp);
+    sized = sized && start >= 0 && end >= start && fseek(fp, start, SEEK_SET) == 0 &&
+        (uint64_t)(end - start) >= sizeof(State) + (uint64_t)header.eventCount * sizeof(Event);
+    if (!sized) {
+        logPrintf(RED "PpuTrace: %s is truncated\n" RESET, path);
+        fclose(fp);
+        return 1;
+    }
+    events.resize(header.eventCount);
+    bool read = fread(&state, sizeof(State), 1, fp) == 1 &&
+        fread(events.data(), sizeof(Event), events.size(), fp) == events.size();
+    fclose(fp);
+    if (!read) {
+        logPrintf(RED "PpuTrace: %s is truncated\n" RESET, path);
+        events.clear();
+        return 1;
+    }
+    frameDots = header.frameDots;
+    frameHash = header.frameHash;
+    return 0;
+}
@@ -0,0 +1,71 @@
+// one frame of everything that reaches the ppu, recorded from a game and replayed without the cpu
+#pragma once
+#include <cstdint>
+#include <vector>
+
+//Emulator::recordPpuTrace fills one in, Emulator::preparePpuReplay and runPpuReplay play it back into the ppu alone
+//the file is a small header, the state and then the events, all stored as is
+class PpuTrace {
+public:
+    //the ppu and everything it reads at the first dot of the frame
+    struct State {
+        uint8_t ctrl;
+        uint8_t mask;
+        uint8_t status;
+        uint8_t oamAddress;
+        uint16_t vramAddress;
+        uint16_t tempVramAddress;
+        uint8_t fineXScroll;
+        uint8_t writeToggle;
+        uint8_t readBuffer;
+        uint8_t spriteCount;
+        int16_t scanline;
+        int16_t cycle;
+        //fetch latches and shift registers, sprites for line 0 come from the evaluation on line 239
+        uint8_t nextTile[4];
+        uint16_t shiftPattern[2];
+        uint16_t shiftAttribute[2];
+        uint8_t spriteInfo[8][4];
+        uint8_t oam[256];
+        uint8_t palettes[32];
+        //both ppu nametables, then the two a four screen cartridge adds
+        uint8_t nameTables[4][1024];
+        //$0000-$1FFF as the ppu saw it, banks already resolved
+        uint8_t chr[0x2000];
+        //a Cartridge::Mirroring
+        uint8_t mirroring;
+        //0 for CHR-ROM, where pattern writes through $2007 are dropped
+        uint8_t chrWritable;
+        uint8_t padding[2];
+    };
+
+    enum EventType : uint8_t {
+        //cpu write to $2000-$2007, address is the register number
+        EVENT_REGISTER_WRITE,
+        //reads have side effects too, the vblank flag, write toggle and read buffer
+        EVENT_REGISTER_READ,
+        //one byte of an OAM DMA, address is the OAM offset
+        EVENT_OAM_DMA,
+        //pattern byte that changed when a mapper switched CHR banks
+        EVENT_CHR,
+        //mapper changed the nametable mirroring, value is a Cartridge::Mirroring
+        EVENT_MIRRORING
+    };
+    struct Event {
+        //ppu dots since the start of the frame
+        uint32_t dot;
+        uint8_t type;
+        uint8_t value;
+        uint16_t address;
+    };
+
+    State state;
+    std::vector<Event> events;
+    //length of the frame in dots and its FrameBuffer::hash, what a replay has to come out as
+    uint32_t frameDots = 0;
+    uint64_t frameHash = 0;
+
+    //return 0 on success
+    int save(const char *path) const;
+    int load(const char *path);
+};
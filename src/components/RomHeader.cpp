@@ -0,0 +1,82 @@
+#include "RomHeader.h"
+#include "Cartridge.h"
+#include <cstring>
+
+//NES 2.0 rom sizes either count banks with a 4 bit msb in byte 9, or with an msb of $F are 2^exponent * multiplier
+//returns 1 for sizes past what Cartridge keeps in an int, the exponent goes up to 63
+static int romSize(uint8_t low, uint8_t msb, uint32_t bankSize, uint32_t &size) {
+    if (msb == 0x0F) {
+        int exponent = low >> 2;
+        if (exponent > 30) {
+            return 1;
+        }
+        uint64_t bytes = (uint64_t)((low & 0x03) * 2 + 1) << exponent;
+        if (bytes > INT32_MAX) {
+            return 1;
+        }
+        size = bytes;
+        return 0;
+    }
+    size = ((msb << 8) | low) * bankSize;
+    return 0;
+}
+
+//NES 2.0 ram sizes are 64 << shift, 0 for none
+static uint32_t ramSize(uint8_t shift) {
+    return shift ? 64u << shift : 0;
+}
+
+int parseRomHeader(const uint8_t *data, size_t size, RomHeader &header) {
+    //header structure:
+    // 4-> PRGROM size in 16kb chunks
+    // 5-> CHRROM size in 8kb chunks
+    // 6-> bit 0 vertical mirroring, bit 1 battery, bit 2 trainer, bit 3 four screen vram, high nibble mapper low nibble
+    // 7-> high nibble mapper high nibble, bits 2-3 are 2 on NES 2.0 headers
+    // 8-> NES 2.0 mapper msb and submapper, iNES 1 PRG-RAM in 8kb chunks
+    // 9-> NES 2.0 PRG and CHR size msb
+    //10-> NES 2.0 PRG-RAM and battery PRG-RAM shift
+    //11-> NES 2.0 CHR-RAM and battery CHR-RAM shift
+    //12-15-> other flags and padding
+    if (size < 16 || data[0] != 'N' || data[1] != 'E' || data[2] != 'S' || data[3] != 0x1A) {
+        return 1;
+    }
+    memset(&header, 0, sizeof(header));
+
+    header.nes2 = (data[7] & 0x0C) == 0x08;
+    header.battery = (data[6] & 0x02) != 0;
+    header.trainer = (data[6] & 0x04) != 0;
+    if (data[6] & 0x08) {
+        header.mirroring = Cartridge::MIRROR_FOUR_SCREEN;
+    } else {
+        header.mirroring = (data[6] & 0x01) ? Cartridge::MIRROR_VERTICAL : Cartridge::MIRROR_HORIZONTAL;
+    }
+
+    if (header.nes2) {
+        header.mapper = (data[6] >> 4) | (data[7] & 0xF0) | ((data[8] & 0x0F) << 8);
+        header.submapper = data[8] >> 4;
+        if (romSize(data[4], data[9] & 0x0F, PRG_ROM_BANKSIZE, header.prgSize) != 0 ||
+            romSize(data[5], data[9] >> 4, CHR_ROM_BANKSIZE, header.chrSize) != 0) {
+            return 1;
+        }
+        header.prgRamSize = ramSize(data[10] & 0x0F);
+        header.prgNvramSize = ramSize(data[10] >> 4);
+        header.chrRamSize = ramSize(data[11] & 0x0F) + ramSize(data[11] >> 4);
+        return 0;
+    }
+
+    //old dumps have junk like "DiskDude!" in the padding, which would show up in byte 7
+    bool dirtyPadding = (data[7] & 0x0C) == 0 && (data[12] || data[13] || data[14] || data[15]);
+    header.mapper = (data[6] >> 4) | (dirtyPadding ? 0 : (data[7] & 0xF0));
+    header.prgSize = data[4] * PRG_ROM_BANKSIZE;
+    header.chrSize = data[5] * CHR_ROM_BANKSIZE;
+
+    //iNES 1 has no reliable ram sizes, assume 8kb of PRG-RAM and CHR-RAM when there is no CHR-ROM
+    uint32_t workRam = (dirtyPadding || data[8] == 0) ? PRG_RAM_SIZE : data[8] * PRG_RAM_SIZE;
+    if (header.battery) {
+        header.prgNvramSize = workRam;
+    } else {
+        header.prgRamSize = workRam;
+    }
+    header.chrRamSize = header.chrSize == 0 ? CHR_ROM_BANKSIZE : 0;
+    return 0;
+}
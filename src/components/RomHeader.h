@@ -0,0 +1,35 @@
+// cartridge configuration from an iNES or NES 2.0 header
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+//fixed layout, it is stored as is in the rom library index
+struct RomHeader {
+    uint16_t mapper;
+    uint8_t submapper;
+    //a Cartridge::Mirroring
+    uint8_t mirroring;
+    uint8_t battery;
+    //512 byte trainer between the header and PRG-ROM
+    uint8_t trainer;
+    uint8_t nes2;
+    uint8_t reserved;
+    //in bytes, chrSize is 0 on boards with CHR-RAM
+    uint32_t prgSize;
+    uint32_t chrSize;
+    uint32_t prgRamSize;
+    uint32_t prgNvramSize;
+    uint32_t chrRamSize;
+
+    //where PRG-ROM starts in the file
+    inline size_t prgOffset() const {
+        return 16 + (trainer ? 512 : 0);
+    }
+    //header, trainer, PRG and CHR, anything after is ignored
+    inline size_t fileSize() const {
+        return prgOffset() + prgSize + chrSize;
+    }
+};
+
+//fills header from the start of a rom file, returns 0 if it starts with a valid iNES header
+int parseRomHeader(const uint8_t *data, size_t size, RomHeader &header);
@@ -0,0 +1,65 @@
+#include "RomImage.h"
+#include "../Definitions.h"
+#include <cstdio>
+#include <map>
+#include <tuple>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//open images by file identity, so different spellings of a path share one mapping and a rewritten file gets a new one
+typedef std::tuple<dev_t, ino_t, time_t, off_t> RomKey;
+static std::map<RomKey, std::weak_ptr<RomImage>> openImages;
+static std::mutex openImagesMutex;
+
+RomImage::RomImage(const uint8_t *bytes, size_t length) {
+    this->bytes = bytes;
+    this->length = length;
+}
+
+RomImage::~RomImage() {
+    munmap((void *)bytes, length);
+}
+
+std::shared_ptr<RomImage> RomImage::open(const char *path) {
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        close(fd);
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(openImagesMutex);
+    RomKey key(info.st_dev, info.st_ino, info.st_mtime, info.st_size);
+    std::shared_ptr<RomImage> image = openImages[key].lock();
+    if (image) {
+        close(fd);
+        return image;
+    }
+
+    //the mapping outlives the descriptor
+    void *mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return nullptr;
+    }
+    image = std::shared_ptr<RomImage>(new RomImage((const uint8_t *)mapping, info.st_size));
+    openImages[key] = image;
+
+    //drop entries of images that were closed since
+    for (auto entry = openImages.begin(); entry != openImages.end();) {
+        entry = entry->second.expired() ? openImages.erase(entry) : std::next(entry);
+    }
+    return image;
+}
+
+TileCache *RomImage::chrTiles(const uint8_t *chr, int size) {
+    std::call_once(tilesBuilt, [&]() {
+        tiles.build(chr, size);
+    });
+    return &tiles;
+}
@@ -0,0 +1,34 @@
+// read only memory mapped rom file, shared by every cartridge in the process that loads it
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include "TileCache.h"
+
+class RomImage {
+public:
+    //maps the file at path, or hands out the image already mapped for the same file. the image is unmapped once
+    //the last cartridge using it is gone. nullptr if the file cant be opened or mapped
+    static std::shared_ptr<RomImage> open(const char *path);
+    ~RomImage();
+
+    const uint8_t *data() const {
+        return bytes;
+    }
+    size_t size() const {
+        return length;
+    }
+
+    //decoded CHR-ROM, built by the first cartridge that asks and only read after that
+    TileCache *chrTiles(const uint8_t *chr, int size);
+
+private:
+    RomImage(const uint8_t *bytes, size_t length);
+
+    const uint8_t *bytes;
+    size_t length;
+
+    TileCache tiles;
+    std::once_flag tilesBuilt;
+};
@@ -0,0 +1,397 @@
+#include "RomLibrary.h"
+#include "RomImage.h"
+#include "Cartridge.h"
+#include "../Definitions.h"
+#include "../Log.h"
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
+#include <climits>
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char INDEX_MAGIC[8] = {'N', 'E', 'S', 'I', 'D', 'X', 0, 0};
+static const uint32_t INDEX_VERSION = 1;
+
+struct IndexHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t count;
+    uint32_t stringsSize;
+    uint32_t entrySize;
+};
+
+//hashes
+
+static uint32_t crc32(const uint8_t *data, size_t size) {
+    static uint32_t table[256];
+    static std::once_flag tableBuilt;
+    std::call_once(tableBuilt, []() {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t value = i;
+            for (int bit = 0; bit < 8; bit++) {
+                value = (value & 1) ? (value >> 1) ^ 0xEDB88320 : value >> 1;
+            }
+            table[i] = value;
+        }
+    });
+
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < size; i++) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static inline uint32_t rotateLeft(uint32_t value, int bits) {
+    return (value << bits) | (value >> (32 - bits));
+}
+
+static void sha1Block(uint32_t state[5], const uint8_t *block) {
+    uint32_t w[80];
+    for (int i = 0; i < 16; i++) {
+        w[i] = (block[i * 4] << 24) | (block[i * 4 + 1] << 16) | (block[i * 4 + 2] << 8) | block[i * 4 + 3];
+    }
+    for (int i = 16; i < 80; i++) {
+        w[i] = rotateLeft(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+    for (int i = 0; i < 80; i++) {
+        uint32_t f, k;
+        if (i < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999;
+        } else if (i < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1;
+        } else if (i < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDC;
+        } else {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6;
+        }
+        uint32_t temp = rotateLeft(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = rotateLeft(b, 30);
+        b = a;
+        a = temp;
+    }
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+}
+
+static void sha1(const uint8_t *data, size_t size, uint8_t digest[20]) {
+    uint32_t state[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    size_t whole = size & ~(size_t)63;
+    for (size_t offset = 0; offset < whole; offset += 64) {
+        sha1Block(state, data + offset);
+    }
+
+    //the rest, a 1 bit, zeros and the bit length in the last 8 bytes, which may spill into a second block
+    uint8_t tail[128] = {0};
+    size_t rest = size - whole;
+    memcpy(tail, data + whole, rest);
+    tail[rest] = 0x80;
+    size_t tailSize = rest < 56 ? 64 : 128;
+    uint64_t bits = (uint64_t)size * 8;
+    for (int i = 0; i < 8; i++) {
+        tail[tailSize - 1 - i] = bits >> (i * 8);
+    }
+    for (size_t offset = 0; offset < tailSize; offset += 64) {
+        sha1Block(state, tail + offset);
+    }
+
+    for (int i = 0; i < 20; i++) {
+        digest[i] = state[i / 4] >> (24 - (i % 4) * 8);
+    }
+}
+
+//header database
+
+//one line per rom, the crc32 of its contents then whatever fields of the header are wrong:
+//  <crc32> [mapper=N] [submapper=N] [mirroring=h|v|4] [prg=KB] [chr=KB] [prgram=KB] [battery=0|1]
+//blank lines and lines starting with # are skipped
+static std::map<uint32_t, std::string> loadHeaderFixes(const char *path) {
+    std::map<uint32_t, std::string> fixes;
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL) {
+        return fixes;
+    }
+    char line[256];
+    while (fgets(line, sizeof(line), fp)) {
+        char *end;
+        uint32_t crc = strtoul(line, &end, 16);
+        if (line[0] == '#' || end == line) {
+            continue;
+        }
+        fixes[crc] = end;
+    }
+    fclose(fp);
+    return fixes;
+}
+
+static void applyHeaderFix(RomHeader &header, const std::string &fix) {
+    char fields[256];
+    snprintf(fields, sizeof(fields), "%s", fix.c_str());
+    for (char *field = strtok(fields, " \t\r\n"); field != nullptr; field = strtok(nullptr, " \t\r\n")) {
+        char *value = strchr(field, '=');
+        if (value == nullptr) {
+            continue;
+        }
+        *value++ = '\0';
+        long number = strtol(value, nullptr, 10);
+        if (strcmp(field, "mapper") == 0) {
+            header.mapper = number;
+        } else if (strcmp(field, "submapper") == 0) {
+            header.submapper = number;
+        } else if (strcmp(field, "mirroring") == 0) {
+            header.mirroring = value[0] == 'v' ? Cartridge::MIRROR_VERTICAL :
+                value[0] == '4' ? Cartridge::MIRROR_FOUR_SCREEN : Cartridge::MIRROR_HORIZONTAL;
+        } else if (strcmp(field, "prg") == 0) {
+            header.prgSize = number * 1024;
+        } else if (strcmp(field, "chr") == 0) {
+            header.chrSize = number * 1024;
+            header.chrRamSize = number ? 0 : CHR_ROM_BANKSIZE;
+        } else if (strcmp(field, "prgram") == 0) {
+            (header.battery ? header.prgNvramSize : header.prgRamSize) = number * 1024;
+        } else if (strcmp(field, "battery") == 0) {
+            //the ram moves between the battery and plain sizes with the flag
+            uint32_t workRam = header.prgRamSize + header.prgNvramSize;
+            header.battery = number != 0;
+            header.prgRamSize = header.battery ? 0 : workRam;
+            header.prgNvramSize = header.battery ? workRam : 0;
+        }
+    }
+}
+
+//scanning
+
+struct ScannedRom {
+    RomLibrary::Entry entry;
+    std::string path;
+    std::string name;
+    bool valid = false;
+};
+
+static void scanRom(ScannedRom &rom, const std::map<uint32_t, std::string> &fixes) {
+    struct stat info;
+    if (stat(rom.path.c_str(), &info) != 0) {
+        return;
+    }
+    std::shared_ptr<RomImage> image = RomImage::open(rom.path.c_str());
+    if (image == nullptr) {
+        return;
+    }
+
+    RomLibrary::Entry &entry = rom.entry;
+    memset(&entry, 0, sizeof(entry));
+    if (parseRomHeader(image->data(), image->size(), entry.header) != 0) {
+        return;
+    }
+    size_t start = std::min(entry.header.prgOffset(), image->size());
+    entry.crc32 = crc32(image->data() + start, image->size() - start);
+    sha1(image->data() + start, image->size() - start, entry.sha1);
+    entry.fileSize = info.st_size;
+    entry.modified = info.st_mtime;
+
+    auto fix = fixes.find(entry.crc32);
+    if (fix != fixes.end()) {
+        applyHeaderFix(entry.header, fix->second);
+        entry.headerFixed = 1;
+    }
+    rom.valid = true;
+}
+
+RomLibrary::RomLibrary() {
+    this->mapping = nullptr;
+    this->mappingSize = 0;
+    this->entries = nullptr;
+    this->count = 0;
+    this->strings = nullptr;
+}
+
+RomLibrary::~RomLibrary() {
+    close();
+}
+
+void RomLibrary::close() {
+    if (mapping != nullptr) {
+        munmap((void *)mapping, mappingSize);
+    }
+    mapping = nullptr;
+    mappingSize = 0;
+    entries = nullptr;
+    count = 0;
+    strings = nullptr;
+}
+
+int RomLibrary::open(const char *indexPath) {
+    close();
+    int fd = ::open(indexPath, O_RDONLY);
+    if (fd < 0) {
+        return 1;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(IndexHeader)) {
+        ::close(fd);
+        return 1;
+    }
+    void *file = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (file == MAP_FAILED) {
+        return 1;
+    }
+    mapping = (const uint8_t *)file;
+    mappingSize = info.st_size;
+
+    //an index from another version or a half written file is rebuilt rather than trusted
+    const IndexHeader *header = (const IndexHeader *)mapping;
+    size_t expected = sizeof(IndexHeader) + (size_t)header->count * sizeof(Entry) + header->stringsSize;
+    if (memcmp(header->magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0 || header->version != INDEX_VERSION ||
+        header->entrySize != sizeof(Entry) || expected != mappingSize) {
+        logPrintf(YELLOW "RomLibrary: Index %s is out of date\n" RESET, indexPath);
+        close();
+        return 1;
+    }
+    entries = (const Entry *)(mapping + sizeof(IndexHeader));
+    count = header->count;
+    strings = (const char *)(entries + count);
+
+    logPrintf(GREEN "RomLibrary: Mapped %d roms from %s\n" RESET, count, indexPath);
+    return 0;
+}
+
+int RomLibrary::build(const char *directory, const char *indexPath, const char *fixesPath) {
+    logPrintf(YELLOW "RomLibrary: Scanning %s\n" RESET, directory);
+
+    namespace fs = std::filesystem;
+    std::vector<ScannedRom> roms;
+    std::error_code error;
+    for (fs::recursive_directory_iterator it(directory, fs::directory_options::skip_permission_denied, error), end;
+         !error && it != end; it.increment(error)) {
+        if (!it->is_regular_file(error) || it->path().extension() != ".nes") {
+            continue;
+        }
+        ScannedRom rom;
+        rom.path = fs::weakly_canonical(it->path(), error).string();
+        rom.name = it->path().stem().string();
+        roms.push_back(rom);
+    }
+    if (error) {
+        logPrintf(RED "RomLibrary: Could not scan %s\n" RESET, directory);
+        return 1;
+    }
+
+    //files are handed out one at a time so a few large roms dont hold up one thread
+    std::map<uint32_t, std::string> fixes = loadHeaderFixes(fixesPath);
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        for (size_t i = next++; i < roms.size(); i = next++) {
+            scanRom(roms[i], fixes);
+        }
+    };
+    size_t threadCount = std::max(1u, std::thread::hardware_concurrency());
+    threadCount = std::min(threadCount, std::max<size_t>(roms.size(), 1));
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < threadCount; i++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+
+    //sorted by path so find can binary search the mapping
+    roms.erase(std::remove_if(roms.begin(), roms.end(), [](const ScannedRom &rom) { return !rom.valid; }), roms.end());
+    std::sort(roms.begin(), roms.end(), [](const ScannedRom &a, const ScannedRom &b) { return a.path < b.path; });
+
+    std::string stringTable;
+    std::vector<Entry> table;
+    int fixed = 0;
+    for (ScannedRom &rom : roms) {
+        rom.entry.pathOffset = stringTable.size();
+        stringTable.append(rom.path).push_back('\0');
+        rom.entry.nameOffset = stringTable.size();
+        stringTable.append(rom.name).push_back('\0');
+        table.push_back(rom.entry);
+        fixed += rom.entry.headerFixed;
+    }
+
+    IndexHeader header;
+    memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    header.version = INDEX_VERSION;
+    header.count = table.size();
+    header.stringsSize = stringTable.size();
+    header.entrySize = sizeof(Entry);
+
+    //written next to the old index and renamed over it, so a running instance never maps a partial file
+    std::string tempPath = std::string(indexPath) + ".tmp";
+    FILE *fp = fopen(tempPath.c_str(), "wb");
+    if (fp == NULL) {
+        logPrintf(RED "RomLibrary: Could not write index %s\n" RESET, indexPath);
+        return 1;
+    }
+    bool written = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+        fwrite(table.data(), sizeof(Entry), table.size(), fp) == table.size() &&
+        fwrite(stringTable.data(), 1, stringTable.size(), fp) == stringTable.size();
+    written = fclose(fp) == 0 && written;
+    if (!written || rename(tempPath.c_str(), indexPath) != 0) {
+        logPrintf(RED "RomLibrary: Could not write index %s\n" RESET, indexPath);
+        remove(tempPath.c_str());
+        return 1;
+    }
+
+    logPrintf(GREEN "RomLibrary: Indexed %d roms with %d threads, %d headers fixed\n" RESET, (int)table.size(), (int)threadCount, fixed);
+    return open(indexPath);
+}
+
+const RomLibrary::Entry *RomLibrary::find(const char *romPath) const {
+    char canonical[PATH_MAX];
+    if (count == 0 || realpath(romPath, canonical) == nullptr) {
+        return nullptr;
+    }
+    const Entry *end = entries + count;
+    const Entry *found = std::lower_bound(entries, end, canonical, [this](const Entry &entry, const char *key) {
+        return strcmp(path(entry), key) < 0;
+    });
+    if (found == end || strcmp(path(*found), canonical) != 0) {
+        return nullptr;
+    }
+
+    //a file rewritten since the scan is parsed again by the cartridge
+    struct stat info;
+    if (stat(canonical, &info) != 0 || (uint64_t)info.st_size != found->fileSize || info.st_mtime != found->modified) {
+        return nullptr;
+    }
+    return found;
+}
+
+void RomLibrary::search(const char *text, std::vector<int> &results) const {
+    results.clear();
+    std::string lowered = text;
+    std::transform(lowered.begin(), lowered.end(), lowered.begin(), ::tolower);
+    for (int i = 0; i < count; i++) {
+        const char *candidate = path(entries[i]);
+        const char *end = candidate + strlen(candidate);
+        auto match = std::search(candidate, end, lowered.begin(), lowered.end(),
+            [](char a, char b) { return tolower((unsigned char)a) == b; });
+        if (match != end || lowered.empty()) {
+            results.push_back(i);
+        }
+    }
+}
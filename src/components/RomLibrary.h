@@ -0,0 +1,67 @@
+// index of the roms under a directory tree, kept in a memory mapped file
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "RomHeader.h"
+
+//the index is a small header, the entries sorted by path and a string table of paths and names. it is written once
+//by build and mapped read only after that, so picking a rom is a binary search instead of opening and parsing files
+class RomLibrary {
+public:
+    //one rom, stored as is in the index file
+    struct Entry {
+        //of everything after the header and trainer, which is what header fixes are keyed by
+        uint32_t crc32;
+        uint8_t sha1[20];
+        //into the string table, canonical path and file name without extension
+        uint32_t pathOffset;
+        uint32_t nameOffset;
+        //to tell when the file changed since it was indexed
+        uint64_t fileSize;
+        int64_t modified;
+        //header from the file, with any fix from the header database applied
+        RomHeader header;
+        uint8_t headerFixed;
+        uint8_t padding[3];
+    };
+
+    RomLibrary();
+    ~RomLibrary();
+
+    //maps an index written by build, returns 0 on success
+    int open(const char *indexPath);
+    //indexes every .nes file under directory with a thread per core, correcting headers from the database at
+    //fixesPath (may be missing), then writes the index to indexPath and maps it. returns 0 on success
+    int build(const char *directory, const char *indexPath, const char *fixesPath);
+
+    int size() const {
+        return count;
+    }
+    const Entry &entry(int index) const {
+        return entries[index];
+    }
+    const char *path(const Entry &entry) const {
+        return strings + entry.pathOffset;
+    }
+    const char *name(const Entry &entry) const {
+        return strings + entry.nameOffset;
+    }
+
+    //entry of the rom at path, nullptr if it isnt indexed or changed since
+    const Entry *find(const char *path) const;
+    //indices of the entries with text in their path, ignoring case, all of them for empty text
+    void search(const char *text, std::vector<int> &results) const;
+
+private:
+    //mapping of the whole index file
+    const uint8_t *mapping;
+    size_t mappingSize;
+
+    const Entry *entries;
+    int count;
+    const char *strings;
+
+    void close();
+};
@@ -0,0 +1,43 @@
+#include "TileCache.h"
+
+TileCache::TileCache() {
+    this->chr = nullptr;
+}
+
+void TileCache::build(const uint8_t *chr, int size) {
+    this->chr = chr;
+
+    //16 bytes per tile, 8 bytes of low bits then 8 of high bits
+    int tiles = size / 16;
+    rows.assign(tiles * 8, 0);
+    flippedRows.assign(tiles * 8, 0);
+    dirty.assign(tiles, 0);
+    versions.assign(tiles, 0);
+
+    for (int tile = 0; tile < tiles; tile++) {
+        decodeTile(tile);
+    }
+}
+
+void TileCache::invalidate(int address) {
+    dirty[address >> 4] = 1;
+    versions[address >> 4]++;
+}
+
+void TileCache::decodeTile(int tile) {
+    for (int y = 0; y < 8; y++) {
+        uint8_t lowByte = chr[tile * 16 + y];
+        uint8_t highByte = chr[tile * 16 + y + 8];
+
+        uint64_t row = 0;
+        uint64_t flipped = 0;
+        for (int x = 0; x < 8; x++) {
+            uint64_t color = ((lowByte >> (7 - x)) & 0x01) | (((highByte >> (7 - x)) & 0x01) << 1);
+            row |= color << (x * 8);
+            flipped |= color << ((7 - x) * 8);
+        }
+        rows[(tile << 3) | y] = row;
+        flippedRows[(tile << 3) | y] = flipped;
+    }
+    dirty[tile] = 0;
+}
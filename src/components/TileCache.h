@@ -0,0 +1,43 @@
+// decoded CHR tile rows
+#pragma once
+#include <cstdint>
+#include <vector>
+
+class TileCache {
+public:
+    TileCache();
+
+    //decodes every tile in chr, called once the rom is loaded
+    void build(const uint8_t *chr, int size);
+
+    //marks the tile holding this chr byte to be decoded again on its next use, for chr ram writes
+    void invalidate(int address);
+    //bumped every time a tile is invalidated, lets viewers redraw only the tiles that changed
+    inline uint32_t version(int tile) {
+        return versions[tile];
+    }
+
+    //the 8 palette indices (0-3) of the row at a pattern address (tile << 4 | row), leftmost pixel in the lowest byte
+    inline uint64_t row(int address) {
+        int tile = address >> 4;
+        if (dirty[tile]) decodeTile(tile);
+        return rows[(tile << 3) | (address & 0x07)];
+    }
+    //same row mirrored horizontally, for sprites
+    inline uint64_t flippedRow(int address) {
+        int tile = address >> 4;
+        if (dirty[tile]) decodeTile(tile);
+        return flippedRows[(tile << 3) | (address & 0x07)];
+    }
+
+private:
+    const uint8_t *chr;
+
+    //indexed by tile << 3 | row
+    std::vector<uint64_t> rows;
+    std::vector<uint64_t> flippedRows;
+    std::vector<uint8_t> dirty;
+    std::vector<uint32_t> versions;
+
+    void decodeTile(int tile);
+};
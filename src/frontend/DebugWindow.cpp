@@ -1,5 +1,6 @@
 #include "DebugWindow.h"
 #include <stdio.h>
+#include <string.h>
 #include <time.h>
 
 DebugWindow::DebugWindow(SDL_Window* window, SDL_GLContext gl_context, Emulator* emulator, PixelBuffer* pixelBuffer) {
@@ -25,6 +26,12 @@ DebugWindow::DebugWindow(SDL_Window* window, SDL_GLContext gl_context, Emulator*
 }
 
 DebugWindow::~DebugWindow() {
+    //a rescan still running is waited for and thrown away
+    if (rescanThread.joinable()) {
+        rescanThread.join();
+    }
+    delete rescanned;
+
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplSDL2_Shutdown();
     ImGui::DestroyContext();
@@ -113,6 +120,13 @@ void DebugWindow::update(int window_width, int window_height) {
     }
     ImGui::PopStyleColor();
 
+    ImGui::SameLine();
+    //switch back to the table driven cpu core to compare against the specialized handlers
+    bool referenceCore = emulator->getReferenceCore();
+    if (ImGui::Checkbox("Reference CPU Core", &referenceCore)) {
+        emulator->setReferenceCore(referenceCore);
+    }
+
     ImGui::SameLine();
     bool logging = emulator->logging;
     ImGui::PushStyleColor(ImGuiCol_Text, logging ? ImVec4(0.1f, 0.9f, 0.1f, 1.0f) : ImVec4(0.9f, 0.1f, 0.1f, 1.0f));
@@ -121,7 +135,18 @@ void DebugWindow::update(int window_width, int window_height) {
 
     ImGui::Separator();
 
-    ImGui::Text("Instruction Count: %i | CPU Cycs: %i | Eticks: %i", emulator->instructionCount, *emulator->getCycleCount(), emulator->emulationTicks);
+    ImGui::Text("Instruction Count: %i | CPU Cycs: %i | Eticks: %lld", emulator->instructionCount, *emulator->getCycleCount(), emulator->emulationTicks);
+
+    //threaded block backend, cross check replays each block through the interpreter
+    ImGui::Checkbox("Block Backend", emulator->getBlockBackend());
+    ImGui::SameLine();
+    ImGui::Checkbox("Cross Check", emulator->getBlockCrossCheck());
+    ImGui::SameLine();
+    ImGui::Text("Blocks: %i | Mismatches: %i", emulator->getBlocksTranslated(), emulator->getBlockMismatches());
+
+    ImGui::Checkbox("Idle Loop Skip", emulator->getIdleSkip());
+    ImGui::SameLine();
+    ImGui::Text("Cycles Skipped: %lld", emulator->getIdleCyclesSkipped());
 
     cpuDebugInfo();
     ppuDebugInfo();
@@ -138,6 +163,72 @@ void DebugWindow::update(int window_width, int window_height) {
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 }
 
+void DebugWindow::romLibraryList() {
+    RomLibrary *library = emulator->library;
+    if (library == nullptr) {
+        return;
+    }
+
+    //the finished library replaces the old one between frames, nothing else holds on to its entries
+    if (rescanThread.joinable() && rescanDone) {
+        rescanThread.join();
+        if (rescanResult == 0) {
+            delete library;
+            library = rescanned;
+            emulator->library = library;
+            romSearchChanged = true;
+        } else {
+            delete rescanned;
+        }
+        rescanned = nullptr;
+    }
+
+    //build renames the new index over the old one, so the old mapping stays valid while it scans
+    bool scanning = rescanThread.joinable();
+    ImGui::BeginDisabled(scanning);
+    if (ImGui::Button(scanning ? "Scanning..." : "Rescan")) {
+        rescanned = new RomLibrary();
+        rescanDone = false;
+        rescanThread = std::thread([this]() {
+            rescanResult = rescanned->build(ROM_DIRECTORY, ROM_INDEX_PATH, HEADER_FIXES_PATH);
+            rescanDone = true;
+        });
+    }
+    ImGui::EndDisabled();
+    ImGui::SameLine();
+    romSearchChanged |= ImGui::InputText("Search ROMs", romSearch, sizeof(romSearch));
+    if (romSearchChanged) {
+        library->search(romSearch, romMatches);
+        romSearchChanged = false;
+    }
+
+    //picking a rom puts its path in the name field and loads it, the clipper only lays out the visible rows
+    if (ImGui::BeginListBox("##roms", ImVec2(-FLT_MIN, 6 * ImGui::GetTextLineHeightWithSpacing()))) {
+        ImGuiListClipper clipper;
+        clipper.Begin(romMatches.size());
+        while (clipper.Step()) {
+            for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++) {
+                const RomLibrary::Entry &entry = library->entry(romMatches[i]);
+                ImGui::PushID(romMatches[i]);
+                bool selected = strcmp(emulator->cartName, library->path(entry)) == 0;
+                if (ImGui::Selectable(library->name(entry), selected)) {
+                    snprintf(emulator->cartName, sizeof(emulator->cartName), "%s", library->path(entry));
+                    printf(YELLOW "Debug: Cartridge Load\n" RESET);
+                    emulator->loadCartridge(emulator->cartName);
+                    emulator->reset();
+                }
+                if (ImGui::IsItemHovered()) {
+                    ImGui::SetTooltip("%s\nmapper %i.%i, PRG %ikb, CHR %ikb%s", library->path(entry), entry.header.mapper, entry.header.submapper,
+                        entry.header.prgSize / 1024, entry.header.chrSize / 1024, entry.headerFixed ? ", header fixed" : "");
+                }
+                ImGui::PopID();
+            }
+        }
+        ImGui::EndListBox();
+    }
+    ImGui::Text("%i of %i roms", (int)romMatches.size(), library->size());
+}
+
 void DebugWindow::ppuDebugInfo() {
     ImGui::Separator();
     //swap cartridge
@@ -148,6 +239,7 @@ void DebugWindow::ppuDebugInfo() {
     }
     ImGui::SameLine();
     ImGui::InputText("ROM Name", emulator->cartName, sizeof(emulator->cartName));
+    romLibraryList();
 
     if (emulator->cartridgeLoaded == true) {
         //load only once cart is loaded to avoid segfault, since this data (shouldnt) exist untill then
@@ -162,6 +254,17 @@ void DebugWindow::ppuDebugInfo() {
 
         ImGui::Text("Cycle: %i, Scanline: %i", emulator->getPPUcycle(), emulator->getPPUscanline());
 
+        //verify renders every line both ways and reports lines where the scanline renderer differs
+        ImGui::Text("Renderer:");
+        ImGui::SameLine();
+        ImGui::RadioButton("Dot", emulator->getRenderMode(), PPU::RENDER_DOT);
+        ImGui::SameLine();
+        ImGui::RadioButton("Scanline", emulator->getRenderMode(), PPU::RENDER_SCANLINE);
+        ImGui::SameLine();
+        ImGui::RadioButton("Verify", emulator->getRenderMode(), PPU::RENDER_VERIFY);
+        ImGui::SameLine();
+        ImGui::Text("Lines: %i | Mismatches: %i", emulator->getScanlinesVerified(), emulator->getScanlineMismatches());
+
         ImGui::Text("Pattern Tables:");
 
         ImGui::Image(pixelBuffer->getPatternTableTexture(0), ImVec2(128 * PATTERN_TABLE_SCALING_VALUE, 128 * PATTERN_TABLE_SCALING_VALUE));
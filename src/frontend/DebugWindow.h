@@ -1,6 +1,8 @@
 //a class to hold imgui calls to avoid an unreadable main class
 
 #pragma once
+#include <thread>
+#include <atomic>
 #include "SDL.h"
 #include "imgui/imgui.h"
 #include "imgui/imgui_impl_sdl2.h"
@@ -19,6 +21,8 @@ public:
     //functions to further abstract all the different pages
     void ppuDebugInfo();
     void cpuDebugInfo();
+    //searchable list of the roms in the emulator's library
+    void romLibraryList();
 
     //variables to track and change things about the debug window 
 
@@ -34,6 +38,16 @@ private:
     Emulator* emulator;
     PixelBuffer* pixelBuffer;
 
+    //rom library search box and the library indices matching it
+    char romSearch[128] = "";
+    std::vector<int> romMatches;
+    bool romSearchChanged = true;
+    //rescans build a new library on a worker thread, the ui keeps using the old one until it is swapped in
+    std::thread rescanThread;
+    std::atomic<bool> rescanDone{false};
+    RomLibrary *rescanned = nullptr;
+    int rescanResult = 0;
+
     //for rendering cpu status flags
     const char* flagNames = "CZIDB-VN";
 };
\ No newline at end of file
@@ -23,9 +23,33 @@ void PixelBuffer::update(bool update) {
         return; 
     }
 
+    if (frame) {
+        frame->expand(pixel_buffer_buffer, width * sizeof(uint32_t), FrameBuffer::FORMAT_RGBA8888);
+    }
     SDL_UpdateTexture(texture, NULL, pixel_buffer_buffer, width * sizeof(uint32_t));
 }
 
+void PixelBuffer::frameReady(const FrameBuffer &frame) {
+    this->frame = &frame;
+}
+
+void PixelBuffer::patternTableReady(const uint32_t *pixels, int table) {
+    //opengl texture insists on abgr format, no idea why, quick fix flips color channels
+    uint32_t flipped[128 * 128];
+    for (int i = 0; i < 128 * 128; i++) {
+        uint32_t color = pixels[i];
+        flipped[i] = ((color & 0xFF000000) >> 24) | ((color & 0x00FF0000) >> 8)  | ((color & 0x0000FF00) << 8)  | ((color & 0x000000FF) << 24);
+    }
+    addPixelArrayToPatternTable(flipped, table);
+}
+
+void PixelBuffer::palettesReady(const uint32_t *colors) {
+    for (int i = 0; i < 32; i++) {
+        uint32_t color = colors[i];
+        palettes[i / 4][i % 4] = ImVec4(((color & 0xFF000000) >> 24) / 255.0f, ((color & 0x00FF0000) >> 16) / 255.0f, ((color & 0x0000FF00) >> 8) / 255.0f, 1.0f);
+    }
+}
+
 //functions for changing individual pixels in the main texture, either by index or coords
 void PixelBuffer::writeBufferPixel(int x, int y, uint32_t color)
 {
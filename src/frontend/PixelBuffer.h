@@ -4,8 +4,10 @@
 #include <vector>
 #include <GLFW/glfw3.h>
 #include "../imgui/imgui.h"
+#include "../components/FrameBuffer.h"
+#include "../FrameSink.h"
 
-class PixelBuffer {
+class PixelBuffer : public FrameSink {
 public:
     PixelBuffer(SDL_Renderer* renderer, int width, int height);
     ~PixelBuffer();
@@ -13,6 +15,10 @@ public:
     // turns array of pixel information into texture and puts into the pattern table buffer
 
     void update(bool update);
+    //the emulator's output, the last frame gets expanded into the texture on update
+    void frameReady(const FrameBuffer &frame) override;
+    void patternTableReady(const uint32_t *pixels, int table) override;
+    void palettesReady(const uint32_t *colors) override;
     uint32_t* getBuffer();
     SDL_Texture* getTexture();
     void writeBufferPixel(int x, int y, uint32_t color);
@@ -29,6 +35,7 @@ public:
         SDL_Texture* texture;
         SDL_Renderer* renderer;
         uint32_t* pixel_buffer_buffer;
+        const FrameBuffer* frame = nullptr;
         int width, height;
 
         //pattern table
@@ -0,0 +1,151 @@
+#include "nescore.h"
+#include "Emulator.h"
+#include "FrameSink.h"
+#include "Log.h"
+#include <new>
+
+//the handle is the emulator's frame sink, frames are passed on to the embedder's callback
+struct nes_emulator : public FrameSink {
+    Emulator *emulator = nullptr;
+    nes_frame_callback callback = nullptr;
+    void *user = nullptr;
+
+    void frameReady(const FrameBuffer &frame) override {
+        if (callback) {
+            callback(user, frame.pixels, frame.emphasis);
+        }
+    }
+};
+
+static_assert(NES_FRAME_WIDTH == DEFAULT_WIDTH && NES_FRAME_HEIGHT == DEFAULT_HEIGHT, "frame size out of sync");
+static_assert(NES_ERROR_BAD_SIZE == (int)Cartridge::LOAD_BAD_SIZE, "load results out of sync");
+
+nes_emulator *nes_create(void) {
+    nes_emulator *nes = new (std::nothrow) nes_emulator();
+    if (nes == nullptr) {
+        return nullptr;
+    }
+    nes->emulator = new (std::nothrow) Emulator(nes);
+    if (nes->emulator == nullptr) {
+        delete nes;
+        return nullptr;
+    }
+    return nes;
+}
+
+void nes_destroy(nes_emulator *nes) {
+    if (nes == nullptr) {
+        return;
+    }
+    delete nes->emulator;
+    delete nes;
+}
+
+int nes_load(nes_emulator *nes, const char *path) {
+    if (nes == nullptr || path == nullptr) {
+        return NES_ERROR_INVALID_ARGUMENT;
+    }
+    if (!nes->emulator->loadCartridge(path)) {
+        return nes->emulator->loadResult;
+    }
+    nes->emulator->reset();
+    return NES_OK;
+}
+
+int nes_reset(nes_emulator *nes) {
+    if (nes == nullptr) {
+        return NES_ERROR_INVALID_ARGUMENT;
+    }
+    if (!nes->emulator->cartridgeLoaded) {
+        return NES_ERROR_NO_CARTRIDGE;
+    }
+    nes->emulator->reset();
+    return NES_OK;
+}
+
+int nes_step(nes_emulator *nes, int instructions) {
+    if (nes == nullptr || instructions < 0) {
+        return NES_ERROR_INVALID_ARGUMENT;
+    }
+    if (!nes->emulator->cartridgeLoaded) {
+        return NES_ERROR_NO_CARTRIDGE;
+    }
+    nes->emulator->runUntilBreak(instructions);
+    return NES_OK;
+}
+
+int nes_frame(nes_emulator *nes) {
+    if (nes == nullptr) {
+        return NES_ERROR_INVALID_ARGUMENT;
+    }
+    if (!nes->emulator->cartridgeLoaded) {
+        return NES_ERROR_NO_CARTRIDGE;
+    }
+    nes->emulator->runFrame();
+    return NES_OK;
+}
+
+int nes_frame_count(nes_emulator *nes) {
+    return nes ? nes->emulator->frameCount : 0;
+}
+
+int nes_set_idle_skip(nes_emulator *nes, int enabled) {
+    if (nes == nullptr) {
+        return NES_ERROR_INVALID_ARGUMENT;
+    }
+    *nes->emulator->getIdleSkip() = enabled != 0;
+    return NES_OK;
+}
+
+int nes_set_block_backend(nes_emulator *nes, int enabled) {
+    if (nes == nullptr) {
+        return NES_ERROR_INVALID_ARGUMENT;
+    }
+    *nes->emulator->getBlockBackend() = enabled != 0;
+    return NES_OK;
+}
+
+int nes_set_buttons(nes_emulator *nes, int port, uint8_t buttons) {
+    if (nes == nullptr || port < 0 || port > 1) {
+        return NES_ERROR_INVALID_ARGUMENT;
+    }
+    //the emulator keeps them with right in bit 7 and A in bit 0, the same as the NES_BUTTON bits
+    if (port == 0) {
+        nes->emulator->controller1 = buttons;
+    } else {
+        nes->emulator->controller2 = buttons;
+    }
+    return NES_OK;
+}
+
+uint8_t *nes_ram(nes_emulator *nes) {
+    return nes ? nes->emulator->getRam() : nullptr;
+}
+
+const uint8_t *nes_frame_pixels(nes_emulator *nes) {
+    return nes ? nes->emulator->ppu->frame.pixels : nullptr;
+}
+
+int nes_frame_rgba(nes_emulator *nes, void *output, int pitch) {
+    if (nes == nullptr || output == nullptr || pitch < NES_FRAME_WIDTH * 4) {
+        return NES_ERROR_INVALID_ARGUMENT;
+    }
+    nes->emulator->ppu->frame.expand(output, pitch, FrameBuffer::FORMAT_RGBA8888);
+    return NES_OK;
+}
+
+uint64_t nes_frame_hash(nes_emulator *nes) {
+    return nes ? nes->emulator->ppu->frame.hash() : 0;
+}
+
+void nes_set_frame_callback(nes_emulator *nes, nes_frame_callback callback, void *user) {
+    if (nes == nullptr) {
+        return;
+    }
+    nes->callback = callback;
+    nes->user = user;
+}
+
+void nes_set_log_callback(nes_log_callback callback) {
+    setLogHandler(callback);
+}
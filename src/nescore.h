@@ -0,0 +1,83 @@
+/* c interface to the emulator core, for running it without the sdl frontend */
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct nes_emulator nes_emulator;
+
+/* results, the load errors match Cartridge::LoadResult */
+enum nes_result {
+    NES_OK = 0,
+    NES_ERROR_NOT_FOUND = 1,
+    NES_ERROR_BAD_HEADER = 2,
+    NES_ERROR_UNSUPPORTED_MAPPER = 3,
+    NES_ERROR_BAD_SIZE = 4,
+    NES_ERROR_NO_CARTRIDGE = 5,
+    NES_ERROR_INVALID_ARGUMENT = 6
+};
+
+#define NES_FRAME_WIDTH 256
+#define NES_FRAME_HEIGHT 240
+#define NES_RAM_SIZE 0x800
+
+/* controller bits as the game reads them, A is read first */
+#define NES_BUTTON_A 0x01
+#define NES_BUTTON_B 0x02
+#define NES_BUTTON_SELECT 0x04
+#define NES_BUTTON_START 0x08
+#define NES_BUTTON_UP 0x10
+#define NES_BUTTON_DOWN 0x20
+#define NES_BUTTON_LEFT 0x40
+#define NES_BUTTON_RIGHT 0x80
+
+/* called with every finished frame, 256x240 nes colors (0-63) and the PPUMASK emphasis bits (0-7) of every line.
+   both stay valid until the emulator runs again */
+typedef void (*nes_frame_callback)(void *user, const uint8_t *pixels, const uint8_t *emphasis);
+/* status lines of the core, shared by every emulator in the process */
+typedef void (*nes_log_callback)(const char *line);
+
+/* an emulator without a cartridge, nullptr if it could not be allocated */
+nes_emulator *nes_create(void);
+void nes_destroy(nes_emulator *nes);
+
+/* path of a rom file, or the bare name of one in the rom directory. resets on success */
+int nes_load(nes_emulator *nes, const char *path);
+int nes_reset(nes_emulator *nes);
+
+/* runs instructions cpu instructions, stopping early when a frame is finished */
+int nes_step(nes_emulator *nes, int instructions);
+/* runs until the frame in progress is finished */
+int nes_frame(nes_emulator *nes);
+/* frames finished since the emulator was created */
+int nes_frame_count(nes_emulator *nes);
+
+/* cpu fast paths for nes_frame, nes_step always runs instruction by instruction. both only skip host work, the
+   emulated result is the same either way. idle loop skipping is on by default, the block backend off */
+int nes_set_idle_skip(nes_emulator *nes, int enabled);
+int nes_set_block_backend(nes_emulator *nes, int enabled);
+
+/* buttons held on controller port 0 or 1, NES_BUTTON_* bits */
+int nes_set_buttons(nes_emulator *nes, int port, uint8_t buttons);
+
+/* the NES_RAM_SIZE bytes of cpu ram, can be written to poke values */
+uint8_t *nes_ram(nes_emulator *nes);
+
+/* last finished frame as nes colors, NES_FRAME_WIDTH * NES_FRAME_HEIGHT bytes */
+const uint8_t *nes_frame_pixels(nes_emulator *nes);
+/* the same frame as 0xRRGGBBAA pixels, pitch is the length of an output row in bytes */
+int nes_frame_rgba(nes_emulator *nes, void *output, int pitch);
+/* fnv-1a of the last finished frame's nes colors and emphasis, the hash the bundled tools compare frames with */
+uint64_t nes_frame_hash(nes_emulator *nes);
+/* nullptr stops the callbacks */
+void nes_set_frame_callback(nes_emulator *nes, nes_frame_callback callback, void *user);
+
+/* nullptr silences the core, lines go to stdout until this is called */
+void nes_set_log_callback(nes_log_callback callback);
+
+#ifdef __cplusplus
+}
+#endif
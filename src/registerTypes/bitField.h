@@ -0,0 +1,33 @@
+// compile time bit fields
+#pragma once
+#include <cstdint>
+
+//a run of WIDTH bits starting at bit LSB of a register holding a T, the masks are worked out at compile time
+//so every get or set is a single and/shift
+template <typename T, int LSB, int WIDTH>
+struct BitField {
+    static constexpr T mask = (T)(((1u << WIDTH) - 1) << LSB);
+
+    //value of the field moved down to bit 0
+    static constexpr T get(T value) { return (value & mask) >> LSB; }
+    //value with the field replaced, bits of field that dont fit are dropped
+    static constexpr T set(T value, unsigned field) { return (T)((value & ~mask) | ((field << LSB) & mask)); }
+};
+
+//plain register, the ppu registers build their named fields on top of this
+template <typename T>
+class REG {
+public:
+    constexpr REG() : value(0) {}
+
+    constexpr T getValue() const { return value; }
+    constexpr void setValue(T setValue) { value = setValue; }
+
+    template <typename Field>
+    constexpr T get() const { return Field::get(value); }
+    template <typename Field>
+    constexpr void set(unsigned field) { value = Field::set(value, field); }
+
+protected:
+    T value;
+};
@@ -0,0 +1,116 @@
+// named fields of the ppu registers
+#pragma once
+#include <cstdint>
+#include "bitField.h"
+
+//PPUCTRL ($2000)
+class CTRLREG : public REG<uint8_t> {
+public:
+    using Nametable = BitField<uint8_t, 0, 2>;
+    using Increment = BitField<uint8_t, 2, 1>;
+    using SpritePattern = BitField<uint8_t, 3, 1>;
+    using BackgroundPattern = BitField<uint8_t, 4, 1>;
+    using TallSprites = BitField<uint8_t, 5, 1>;
+    using Nmi = BitField<uint8_t, 7, 1>;
+
+    constexpr uint8_t nametable() const { return get<Nametable>(); }
+    //how far vramAddress moves after a $2007 access
+    constexpr uint8_t increment() const { return get<Increment>() ? 32 : 1; }
+    constexpr uint16_t spritePatternBase() const { return get<SpritePattern>() << 12; }
+    constexpr uint16_t backgroundPatternBase() const { return get<BackgroundPattern>() << 12; }
+    constexpr bool tallSprites() const { return get<TallSprites>(); }
+    constexpr bool nmiEnable() const { return get<Nmi>(); }
+};
+
+//PPUMASK ($2001)
+class MASKREG : public REG<uint8_t> {
+public:
+    using Grayscale = BitField<uint8_t, 0, 1>;
+    using ShowBgLeft = BitField<uint8_t, 1, 1>;
+    using ShowSpritesLeft = BitField<uint8_t, 2, 1>;
+    using ShowBg = BitField<uint8_t, 3, 1>;
+    using ShowSprites = BitField<uint8_t, 4, 1>;
+    using Emphasis = BitField<uint8_t, 5, 3>;
+
+    constexpr bool showBgLeft() const { return get<ShowBgLeft>(); }
+    constexpr bool showSpritesLeft() const { return get<ShowSpritesLeft>(); }
+    constexpr bool showBg() const { return get<ShowBg>(); }
+    constexpr bool showSprites() const { return get<ShowSprites>(); }
+    constexpr uint8_t emphasis() const { return get<Emphasis>(); }
+    //either layer on means the ppu is rendering and moves vramAddress around
+    constexpr bool renderingEnabled() const { return value & (ShowBg::mask | ShowSprites::mask); }
+};
+
+//PPUSTATUS ($2002)
+class STATUSREG : public REG<uint8_t> {
+public:
+    using SpriteOverflow = BitField<uint8_t, 5, 1>;
+    using SpriteZeroHit = BitField<uint8_t, 6, 1>;
+    using Vblank = BitField<uint8_t, 7, 1>;
+
+    constexpr bool spriteOverflow() const { return get<SpriteOverflow>(); }
+    constexpr bool spriteZeroHit() const { return get<SpriteZeroHit>(); }
+    constexpr bool vblank() const { return get<Vblank>(); }
+    constexpr void setSpriteOverflow(bool flag) { set<SpriteOverflow>(flag); }
+    constexpr void setSpriteZeroHit(bool flag) { set<SpriteZeroHit>(flag); }
+    constexpr void setVblank(bool flag) { set<Vblank>(flag); }
+};
+
+//which half of the address a scroll increment or sync works on
+enum Axis {
+    AXIS_X,
+    AXIS_Y
+};
+
+//vramAddress and tempVramAddress, laid out as yyy NN YYYYY XXXXX
+class VRAMADDR : public REG<uint16_t> {
+public:
+    using CoarseX = BitField<uint16_t, 0, 5>;
+    using CoarseY = BitField<uint16_t, 5, 5>;
+    using NametableX = BitField<uint16_t, 10, 1>;
+    using NametableY = BitField<uint16_t, 11, 1>;
+    using Nametable = BitField<uint16_t, 10, 2>;
+    using FineY = BitField<uint16_t, 12, 3>;
+
+    constexpr uint8_t coarseX() const { return get<CoarseX>(); }
+    constexpr uint8_t coarseY() const { return get<CoarseY>(); }
+    constexpr uint8_t nametable() const { return get<Nametable>(); }
+    constexpr uint8_t fineY() const { return get<FineY>(); }
+    constexpr void setCoarseX(uint8_t field) { set<CoarseX>(field); }
+    constexpr void setCoarseY(uint8_t field) { set<CoarseY>(field); }
+    constexpr void setNametable(uint8_t field) { set<Nametable>(field); }
+    constexpr void setFineY(uint8_t field) { set<FineY>(field); }
+
+    //moves to the next tile or row, wrapping into the neighbouring nametable
+    constexpr void increment(Axis axis) {
+        if (axis == AXIS_X) {
+            if (coarseX() == 31) {
+                setCoarseX(0);
+                value ^= NametableX::mask;
+            } else {
+                value++;
+            }
+        } else {
+            if (fineY() < 7) {
+                value += 1 << 12;
+            } else {
+                setFineY(0);
+                if (coarseY() == 29) {
+                    setCoarseY(0);
+                    value ^= NametableY::mask;
+                } else {
+                    //rows 30 and 31 are attribute data, 31 wraps to 0 without switching nametables
+                    setCoarseY(coarseY() + 1);
+                }
+            }
+        }
+    }
+
+    //copies the horizontal (coarse x, nametable x) or vertical (fine y, coarse y, nametable y) bits over
+    constexpr void sync(const VRAMADDR &other, Axis axis) {
+        constexpr uint16_t xMask = CoarseX::mask | NametableX::mask;
+        constexpr uint16_t yMask = FineY::mask | CoarseY::mask | NametableY::mask;
+        uint16_t syncMask = axis == AXIS_X ? xMask : yMask;
+        value = (value & ~syncMask) | (other.value & syncMask);
+    }
+};
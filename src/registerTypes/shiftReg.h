@@ -1,16 +1,35 @@
+#pragma once
 #include <cstdint>
 #include "../Definitions.h"
 
 class SHIFTREG {
     public:
-        SHIFTREG();
-        void shift();
+        //what part of a tile gets loaded into the low byte
+        enum LoadType {
+            PATTERN,
+            ATTRIBUTE
+        };
 
-        //shift type is either a for attribute or p for pattern
-        void loadNextTile(TileInfo next_tile, char shiftType);
+        constexpr void shift()
+        {
+            lowWord = lowWord << 1;
+            highWord = highWord << 1;
+        }
+
+        constexpr void loadNextTile(const TileInfo &next_tile, LoadType type)
+        {
+            if (type == PATTERN) {
+                lowWord |= next_tile.lsb;
+                highWord |= next_tile.msb;
+            } else {
+                //expands attribute bit to full byte
+                lowWord |= (next_tile.attribute & 0b01) ? 0xFF : 0x00;
+                highWord |= (next_tile.attribute & 0b10) ? 0xFF : 0x00;
+            }
+        }
 
         //shift registers used in PPU
 
-        uint16_t lowWord;
-        uint16_t highWord;
-};
\ No newline at end of file
+        uint16_t lowWord = 0;
+        uint16_t highWord = 0;
+};